@@ -5,9 +5,9 @@
 
 // Repository at: https://github.com/djeedjay/DebugViewPP/
 
-#pragma once
-
 #include "stdafx.h"
+#include <cstring>
+#include <algorithm>
 #include "CobaltFusion/CircularBuffer.h"
 #include "CobaltFusion/dbgstream.h"
 
@@ -87,27 +87,29 @@ bool CircularBuffer::Full() const
 
 std::string CircularBuffer::ReadStringZ()
 {
-	//std::cerr << "  ReadStringZ\n";
-
-	std::string message;
-	while (auto ch = Read())
+	// the data is at most two contiguous parts, before and after the end of the buffer
+	size_t size = Size();
+	size_t first = std::min(size, m_capacity + 1 - m_readOffset);
+	auto end = static_cast<const char*>(std::memchr(ReadPointer(), '\0', first));
+	size_t length = end ? end - ReadPointer() : 0;
+	if (!end)
 	{
-		message.push_back(ch);
+		end = static_cast<const char*>(std::memchr(m_buffer.get(), '\0', size - first));
+		if (!end)
+			throw std::exception("Read from empty buffer!");
+		length = first + (end - m_buffer.get());
 	}
-	//std::cerr << "  ReadStringZ done\n";
+
+	std::string message(length, '\0');
+	if (length > 0)
+		Read(&message[0], length);
+	IncreaseReadPointer();
 	return message;
 }
 
 void CircularBuffer::WriteStringZ(const char* message)
 {
-	//std::cerr << "  WriteStringZ\n";
-	while (*message)
-	{
-		Write(*message);
-		++message;
-	}
-	Write('\0');
-	//std::cerr << "  WriteStringZ done\n";
+	Write(message, std::strlen(message) + 1);
 }
 
 size_t CircularBuffer::NextPosition(size_t offset) const
@@ -167,6 +169,36 @@ void CircularBuffer::Write(char value)
 	IncreaseWritePointer();
 }
 
+void CircularBuffer::Read(void* data, size_t size)
+{
+	if (size > Size())
+		throw std::exception("Read from empty buffer!");
+
+	size_t first = std::min(size, m_capacity + 1 - m_readOffset);
+	std::memcpy(data, ReadPointer(), first);
+	std::memcpy(static_cast<char*>(data) + first, m_buffer.get(), size - first);
+	m_readOffset = (m_readOffset + size) % (m_capacity + 1);
+}
+
+void CircularBuffer::Skip(size_t size)
+{
+	if (size > Size())
+		throw std::exception("Read from empty buffer!");
+
+	m_readOffset = (m_readOffset + size) % (m_capacity + 1);
+}
+
+void CircularBuffer::Write(const void* data, size_t size)
+{
+	if (size > Available())
+		throw std::exception("Write to full buffer!");
+
+	size_t first = std::min(size, m_capacity + 1 - m_writeOffset);
+	std::memcpy(WritePointer(), data, first);
+	std::memcpy(m_buffer.get(), static_cast<const char*>(data) + first, size - first);
+	m_writeOffset = (m_writeOffset + size) % (m_capacity + 1);
+}
+
 void CircularBuffer::DumpStats()
 {
 	std::cerr << "  m_readOffset:  " << m_readOffset << "\n";
@@ -13,6 +13,7 @@
 
 #define BOOST_TEST_MODULE CobaltFusionLib Unit Test
 #include <boost/test/unit_test_gui.hpp>
+#include <algorithm>
 #include "CobaltFusion/CircularBuffer.h"
 
 namespace fusion {
@@ -255,6 +256,30 @@ BOOST_AUTO_TEST_CASE(CircularBufferBufferFullTimeout)
 	BOOST_CHECK_EQUAL(readInterations, writeIterations);
 }
 
+BOOST_AUTO_TEST_CASE(CircularBufferBlockWraparound)
+{
+	size_t testsize = 37;
+	CircularBuffer buffer(testsize);
+	std::string text = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+	for (size_t j = 0; j < 500; ++j)
+	{
+		size_t size = j % (testsize + 1);
+		buffer.Write(text.data(), std::min(size, text.size()));
+		BOOST_REQUIRE_EQUAL(buffer.Size(), std::min(size, text.size()));
+
+		std::string s(buffer.Size(), '\0');
+		if (!s.empty())
+			buffer.Read(&s[0], s.size());
+		BOOST_REQUIRE_EQUAL(s, text.substr(0, s.size()));
+		BOOST_REQUIRE(buffer.Empty());
+	}
+
+	BOOST_CHECK_THROW(buffer.Write(std::string(testsize + 1, 'x').data(), testsize + 1), std::exception);
+	char c;
+	BOOST_CHECK_THROW(buffer.Read(&c, 1), std::exception);
+}
+
 BOOST_AUTO_TEST_CASE(CircularBufferSwapping)
 {
 	size_t testsize = 30;
@@ -13,6 +13,7 @@
 #include <algorithm>
 #include <boost/algorithm/string.hpp>
 #include "CobaltFusion/AtlWinExt.h"
+#include "CobaltFusion/make_unique.h"
 #include "CobaltFusion/stringbuilder.h"
 #include "CobaltFusion/dbgstream.h"
 #include "Win32/Registry.h"
@@ -104,6 +105,14 @@ LogLine::LogLine(int line) :
 {
 }
 
+LineClassification::LineClassification() :
+	generation(0),
+	painted(false),
+	filterColor(false),
+	color(Colors::BackGround, Colors::Text)
+{
+}
+
 ItemData::ItemData() :
 	color(Colors::BackGround, Colors::Text)
 {
@@ -187,6 +196,11 @@ CLogView::CLogView(const std::wstring& name, CMainFrame& mainFrame, LogFile& log
 	m_mainFrame(mainFrame),
 	m_logFile(logFile),
 	m_filter(std::move(filter)),
+	m_filterEngine(m_filter),
+	m_filterGeneration(0),
+	m_filterPassBookmark(0),
+	m_filterPassFocusLine(-1),
+	m_filterPassFocusItem(-1),
 	m_firstLine(0),
 	m_clockTime(false),
 	m_processColors(false),
@@ -195,6 +209,10 @@ CLogView::CLogView(const std::wstring& name, CMainFrame& mainFrame, LogFile& log
 	m_dirty(false),
 	m_hBookmarkIcon(static_cast<HICON>(LoadImage(_Module.GetResourceInstance(), MAKEINTRESOURCE(IDR_BOOKMARK), IMAGE_ICON, 0, 0, LR_DEFAULTCOLOR))),
 	m_hBeamCursor(LoadCursor(nullptr, IDC_IBEAM)),
+	m_findDirection(0),
+	m_findNewText(false),
+	m_searchCount(0),
+	m_searchCounted(0),
 	m_dragStart(0, 0),
 	m_dragEnd(0, 0),
 	m_dragging(false),
@@ -563,6 +581,9 @@ void CLogView::OnLButtonUp(UINT /*flags*/, CPoint point)
 
 void CLogView::OnTimer(UINT_PTR nIDEvent)
 {
+	// timer 1 scrolls while dragging a text selection, timer 2 merges the blocks of the filter pass
+	if (nIDEvent == 2)
+		PollFilterPass();
 	if (nIDEvent != 1)
 		return;
 
@@ -713,14 +734,40 @@ std::vector<Highlight> CLogView::GetHighlights(const std::string& text) const
 {
 	std::vector<Highlight> highlights;
 
+	auto insertToken = [&](int id, const Filter& filter, size_t pos, size_t length)
+	{
+		int begin = ExpandedTabOffset(text, static_cast<int>(pos));
+		int end = ExpandedTabOffset(text, static_cast<int>(pos + length));
+
+		if (filter.bgColor == Colors::Auto)
+		{
+			auto itc = m_matchColors.find(text.substr(pos, length));
+			if (itc != m_matchColors.end())
+				InsertHighlight(highlights, Highlight(id, begin, end, TextColor(itc->second, Colors::Text)));
+		}
+		else
+		{
+			InsertHighlight(highlights, Highlight(id, begin, end, TextColor(filter.bgColor, filter.fgColor)));
+		}
+	};
+
 	int highlightId = 1;
 	for (auto it = m_filter.messageFilters.begin(); it != m_filter.messageFilters.end(); ++it)
 	{
 		if (!it->enable || it->filterType != FilterType::Token)
 			continue;
 
-		std::sregex_iterator begin(text.begin(), text.end(), it->re), end;
 		int id = ++highlightId;
+		const auto& pattern = *it->pattern;
+		if (pattern.literal.IsSimple())
+		{
+			size_t length = pattern.literal.Literal().size();
+			for (size_t pos = pattern.literal.Find(text, 0); pos != std::string::npos; pos = pattern.literal.Find(text, pos + length))
+				insertToken(id, *it, pos, length);
+			continue;
+		}
+
+		std::sregex_iterator begin(text.begin(), text.end(), pattern.re), end;
 		for (auto tok = begin; tok != end; ++tok)
 		{
 			int first = 0;
@@ -731,29 +778,65 @@ std::vector<Highlight> CLogView::GetHighlights(const std::string& text) const
 				count = tok->size();
 			}
 			for (int i = first; i < count; ++i)
-			{
-				int begin = ExpandedTabOffset(text, tok->position(i));
-				int end = ExpandedTabOffset(text, tok->position(i) + tok->length(i));
-
-				if (it->bgColor == Colors::Auto)
-				{
-					auto itc = m_matchColors.find(tok->str(i));
-					if (itc != m_matchColors.end())
-						InsertHighlight(highlights, Highlight(id, begin, end, TextColor(itc->second, Colors::Text)));
-				}
-				else
-				{
-					InsertHighlight(highlights, Highlight(id, begin, end, TextColor(it->bgColor, it->fgColor)));
-				}
-			}
+				insertToken(id, *it, tok->position(i), tok->length(i));
 		}
 	}
 
-	InsertHighlight(highlights, text, Str(m_highlightText), TextColor(Colors::Highlight, Colors::Text));
-
 	return highlights;
 }
 
+// bounds the number of lines with a cached LineClassification, the oldest classification is dropped first
+const size_t maxClassifications = 10000;
+
+LineClassification& CLogView::StoreClassification(int line, const LogFilterMatch& match) const
+{
+	auto it = m_classifications.find(line);
+	if (it == m_classifications.end())
+	{
+		if (m_classificationOrder.size() >= maxClassifications)
+		{
+			m_classifications.erase(m_classificationOrder.front());
+			m_classificationOrder.pop_front();
+		}
+		m_classificationOrder.push_back(line);
+		it = m_classifications.insert(std::make_pair(line, LineClassification())).first;
+	}
+
+	auto& classification = it->second;
+	classification.generation = m_filterGeneration;
+	classification.painted = false;
+	classification.highlights.clear();
+
+	size_t messageCount = match.message.filters.size();
+	classification.matched.reset();
+	classification.matched.resize(messageCount + match.process.filters.size());
+	for (size_t i = 0; i < messageCount; ++i)
+		classification.matched[i] = match.message.filters[i] != 0;
+	for (size_t i = 0; i < match.process.filters.size(); ++i)
+		classification.matched[messageCount + i] = match.process.filters[i] != 0;
+	return classification;
+}
+
+const LineClassification& CLogView::GetClassification(int line, const Message& msg) const
+{
+	auto it = m_classifications.find(line);
+	LineClassification* classification = it == m_classifications.end() || it->second.generation != m_filterGeneration ? nullptr : &it->second;
+	if (!classification)
+	{
+		LogFilterMatch match;
+		m_filterEngine.Match(m_filter, msg.processName, msg.text, match);
+		classification = &StoreClassification(line, match);
+	}
+
+	if (!classification->painted)
+	{
+		classification->filterColor = GetFilterColor(msg, *classification, classification->color);
+		classification->highlights = GetHighlights(msg.text);
+		classification->painted = true;
+	}
+	return *classification;
+}
+
 void DrawHighlightedText(HDC hdc, const RECT& rect, std::wstring text, std::vector<Highlight> highlights, const Highlight& selection)
 {
 	InsertHighlight(highlights, selection);
@@ -797,10 +880,14 @@ ItemData CLogView::GetItemData(int iItem) const
 	data.text[Column::Time] = GetItemWText(iItem, ColumnToSubItem(Column::Time));
 	data.text[Column::Pid] = GetItemWText(iItem, ColumnToSubItem(Column::Pid));
 	data.text[Column::Process] = GetItemWText(iItem, ColumnToSubItem(Column::Process));
-	auto text = TabsToSpaces(m_logFile[m_logLines[iItem].line].text);
-	data.highlights = GetHighlights(m_logFile[m_logLines[iItem].line].text);
+	int line = m_logLines[iItem].line;
+	auto msg = m_logFile[line];
+	auto text = TabsToSpaces(msg.text);
+	const auto& classification = GetClassification(line, msg);
+	data.highlights = classification.highlights;
+	InsertHighlight(data.highlights, msg.text, Str(m_highlightText), TextColor(Colors::Highlight, Colors::Text));
 	data.text[Column::Message] = WStr(text).str();
-	data.color = GetTextColor(m_logFile[m_logLines[iItem].line]);
+	data.color = classification.filterColor ? classification.color : TextColor(m_processColors ? msg.color : Colors::BackGround, Colors::Text);
 	return data;
 }
 
@@ -865,17 +952,20 @@ void CLogView::DrawItem(CDCHandle dc, int iItem, unsigned /*iItemState*/) const
 
 std::string CLogView::GetColumnText(int iItem, Column::type column) const
 {
+	// only the message column reads the text of the line
 	int line = m_logLines[iItem].line;
-	const Message& msg = m_logFile[line];
-
 	switch (column)
 	{
 	case Column::Line: return std::to_string(iItem + 1ULL);
-	case Column::Date: return GetDateText(msg.systemTime);
-	case Column::Time: return m_clockTime ? GetTimeText(msg.systemTime) : GetTimeText(msg.time);
-	case Column::Pid: return std::to_string(msg.processId + 0ULL);
-	case Column::Process: return Str(msg.processName).str();
-	case Column::Message: return msg.text;
+	case Column::Date: return m_timestampFormatter.FormatDate(m_logFile.GetSystemTime(line));
+	case Column::Time:
+		{
+			char buf[TimestampFormatter::offsetSize];
+			return std::string(buf, m_clockTime ? m_timestampFormatter.FormatTime(m_logFile.GetSystemTime(line), buf) : TimestampFormatter::FormatOffset(m_logFile.GetTime(line), buf));
+		}
+	case Column::Pid: return std::to_string(m_logFile.GetProcessProperties(m_logFile.GetProcessUid(line)).pid + 0ULL);
+	case Column::Process: return Str(m_logFile.GetProcessProperties(m_logFile.GetProcessUid(line)).name).str();
+	case Column::Message: return m_logFile[line].text;
 	}
 	return std::string();
 }
@@ -926,7 +1016,7 @@ LRESULT CLogView::OnOdStateChanged(NMHDR* pnmh)
 	return 0;
 }
 
-bool Contains(const std::string& text, const std::string& substring)
+bool Contains(boost::string_ref text, const std::string& substring)
 {
 	return !boost::algorithm::ifind_first(text, substring).empty();
 }
@@ -937,11 +1027,12 @@ LRESULT CLogView::OnIncrementalSearch(NMHDR* pnmh)
 	auto& nmhdr = *reinterpret_cast<NMLVFINDITEM*>(pnmh);
 
 	std::string text(Str(nmhdr.lvfi.psz).str());
+	auto query = m_mainFrame.GetTextIndex().Query(text);
 //	int line = nmhdr.iStart; // Does not work as specified...
 	int line = std::max(GetNextItem(-1, LVNI_FOCUSED), 0);
 	while (line != static_cast<int>(m_logLines.size()))
 	{
-		if (Contains(m_logFile[m_logLines[line].line].text, text))
+		if (query.MayContain(m_logLines[line].line) && Contains(m_logFile.GetText(m_logLines[line].line), text))
 		{
 			SetHighlightText(nmhdr.lvfi.psz);
 			nmhdr.lvfi.lParam = line;
@@ -987,10 +1078,11 @@ LRESULT CLogView::OnBeginDrag(NMHDR* pnmh)
 	return 0;
 }
 
+// Clear() starts at line 0 for a cleared LogFile, the lines that are cleared from the view stay hidden
 void CLogView::ClearView()
 {
-	m_firstLine = m_logFile.Count();
 	Clear();
+	m_firstLine = m_logFile.EndIndex();
 }
 
 void CLogView::OnViewClear(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/)
@@ -1083,8 +1175,17 @@ bool CLogView::FindProcess(int direction)
 	if (begin < 0)
 		return false;
 
-	auto processName = m_logFile[m_logLines[begin].line].processName;
-	int line = FindLine([processName, this](const LogLine& line) { return m_logFile[line.line].processName == processName; }, direction);
+	// lines are compared by process uid, the name of each uid is looked up once
+	auto processName = m_logFile.GetProcessProperties(m_logFile.GetProcessUid(m_logLines[begin].line)).name;
+	std::unordered_map<DWORD, bool> sameName;
+	int line = FindLine([&processName, &sameName, this](const LogLine& line) -> bool
+	{
+		auto uid = m_logFile.GetProcessUid(line.line);
+		auto it = sameName.find(uid);
+		if (it == sameName.end())
+			it = sameName.insert(std::make_pair(uid, m_logFile.GetProcessProperties(uid).name == processName)).first;
+		return it->second;
+	}, direction);
 	if (line < 0 || line == begin)
 		return false;
 
@@ -1286,10 +1387,13 @@ void CLogView::SetAutoScrollStop(bool enable)
 
 void CLogView::Clear()
 {
+	CancelFilterPass();
+	m_processFilterCache.Clear();
 	SetItemCount(0);
 	m_dirty = false;
+	m_firstLine = 0;
 	m_logLines.clear();
-	m_highlightText.clear();
+	SetHighlightText();
 	if (m_autoScrollStop)
 		m_autoScrollDown = true;
 
@@ -1313,26 +1417,45 @@ void CLogView::SetFocusLine(int line)
 
 void CLogView::Add(int beginIndex, int line, const Message& msg)
 {
-	if (IsClearMessage(msg))
+	if (m_search)
+		m_search->Notify();
+
+	// lines before beginIndex were dropped from the history, also when this message is not included
+	auto it = m_logLines.begin();
+	while (it != m_logLines.end() && it->line < beginIndex)
+		++it;
+	if (it != m_logLines.begin())
+	{
+		m_logLines.erase(m_logLines.begin(), it);
+		ResetSearchCount();
+		m_dirty = true;
+	}
+
+	// lines that arrive during a filter pass are added in order when the pass is done
+	if (m_filterPass)
+	{
+		m_pendingLines.push_back(line);
+		return;
+	}
+
+	m_filterEngine.Match(m_filter, m_processFilterCache, m_logFile.GetProcessUid(line), msg.processName, msg.text, m_filterMatch);
+	if (IsClearMessage(m_filterMatch))
 		ClearView();
 
-	if (!IsIncluded(msg))
+	if (!IsIncluded(msg, m_filterMatch))
 		return;
 
-	if (IsBeepMessage(msg))
+	if (IsBeepMessage(m_filterMatch))
 		MessageBeep(0xFFFFFFFF);	// A simple beep. If the sound card is not available, the sound is generated using the speaker.
 
 	m_dirty = true;
 	m_changed = true;
-	auto it = m_logLines.begin();
-	while (it != m_logLines.end() && it->line < beginIndex)
-		++it;
-	m_logLines.erase(m_logLines.begin(), it);
 
 	int viewline = m_logLines.size();
 	m_logLines.push_back(LogLine(line));
+	StoreClassification(line, m_filterMatch);
 
-	if (m_autoScrollDown && MatchFilterType(FilterType::Stop, msg))
+	if (m_autoScrollDown && m_filterMatch.Matched(FilterType::Stop))
 	{
 		m_stop = [this, viewline] ()
 		{
@@ -1342,7 +1465,7 @@ void CLogView::Add(int beginIndex, int line, const Message& msg)
 		return;
 	}
 
-	if (MatchFilterType(FilterType::Track, msg))
+	if (m_filterMatch.Matched(FilterType::Track))
 	{
 		m_autoScrollDown = false;
 		m_track = [this, viewline] () 
@@ -1391,6 +1514,8 @@ void CLogView::StopTracking()
 
 void CLogView::StopScrolling()
 {
+	// disabled Track filters no longer color their lines
+	++m_filterGeneration;
 	m_autoScrollDown = false;
 	for (auto it = m_filter.messageFilters.begin(); it != m_filter.messageFilters.end(); ++it)
 	{
@@ -1539,11 +1664,60 @@ std::wstring CLogView::GetHighlightText() const
 
 void CLogView::SetHighlightText(const std::wstring& text)
 {
-	if (m_highlightText != text)
+	if (m_highlightText == text)
+		return;
+
+	// the highlight text is searched in the background, see Find()
+	m_highlightText = text;
+	m_findDirection = 0;
+	m_search.reset();
+	if (!text.empty())
+		m_search = make_unique<LogSearch>(m_logFile, m_mainFrame.GetTextIndex(), Str(text).str(), MatchType::Simple, [this]() { OnSearchUpdate(); });
+	ResetSearchCount();
+	Invalidate(false);
+}
+
+// the number of lines in the view that match the highlight text, -1 when there is no highlight text
+int CLogView::GetSearchMatchCount() const
+{
+	if (!m_search)
+		return -1;
+
+	// each match is counted once, a line that is added to the view gets its match after it was added
+	size_t dropped = m_search->Dropped();
+	size_t end = dropped + m_search->Count();
+	for (size_t i = std::max(m_searchCounted, dropped); i < end; ++i)
 	{
-		m_highlightText = text;
-		Invalidate(false);
+		if (GetViewIndex(m_search->GetMatch(i - dropped)) >= 0)
+			++m_searchCount;
 	}
+	m_searchCounted = end;
+	return static_cast<int>(m_searchCount);
+}
+
+int CLogView::GetSearchProgress() const
+{
+	return m_search ? m_search->Progress() : 100;
+}
+
+// the view lines changed other than by appending lines, the matches are counted again
+void CLogView::ResetSearchCount()
+{
+	m_searchCount = 0;
+	m_searchCounted = 0;
+}
+
+// -1 when 'line' is not in the view
+int CLogView::GetViewIndex(int line) const
+{
+	auto it = std::lower_bound(m_logLines.begin(), m_logLines.end(), line, [](const LogLine& logLine, int line) { return logLine.line < line; });
+	return it == m_logLines.end() || it->line != line ? -1 : static_cast<int>(it - m_logLines.begin());
+}
+
+void CLogView::OnSearchUpdate()
+{
+	if (m_findDirection != 0 && !ContinueFind())
+		MessageBeep(MB_ICONASTERISK);
 }
 
 template <typename Predicate>
@@ -1574,23 +1748,85 @@ int CLogView::FindLine(Predicate pred, int direction) const
 	return -1;
 }
 
+// a new text starts a LogSearch, the focus moves to the next match in 'direction' as soon as the search reached it.
+// returns false when there is no other match to move to.
 bool CLogView::Find(const std::string& text, int direction)
 {
 	StopTracking();
 
-	int line = FindLine([text, this](const LogLine& line) { return Contains(m_logFile[line.line].text, text); }, direction);
-	if (line < 0)
+	auto wtext = WStr(text).str();
+	m_findNewText = wtext != m_highlightText;
+	SetHighlightText(wtext);
+	m_findDirection = direction;
+	return ContinueFind();
+}
+
+bool CLogView::ContinueFind()
+{
+	int index;
+	if (!FindSearchMatch(m_findDirection, index))
+		return true;
+
+	m_findDirection = 0;
+	if (index < 0)
 		return false;
 
-	bool sameLine = GetItemState(line, LVIS_FOCUSED) != 0;
+	bool sameLine = GetItemState(index, LVIS_FOCUSED) != 0;
 	if (!sameLine)
-		ScrollToIndex(line, true);
+	{
+		// moving the focus clears the highlight text, the text and its search are kept
+		std::wstring text = m_highlightText;
+		std::unique_ptr<LogSearch> search(std::move(m_search));
+		ScrollToIndex(index, true);
+		m_highlightText = text;
+		m_search = std::move(search);
+	}
+	return !sameLine || m_findNewText;
+}
 
-	auto wtext = WStr(text).str();
-	if (sameLine && wtext == m_highlightText)
-		return false;
+// the view index of the first match in 'direction' from the focused line, wrapping around to the focused line itself,
+// or -1 when there is none. Returns false when the search did not reach the lines that can hold that match yet.
+bool CLogView::FindSearchMatch(int direction, int& index) const
+{
+	index = -1;
+	if (m_logLines.empty() || !m_search)
+		return true;
 
-	SetHighlightText(wtext);
+	int line = m_logLines[std::max(GetNextItem(-1, LVNI_FOCUSED), 0)].line;
+	int last = m_logLines.back().line;
+	int searched = static_cast<int>(m_search->EndIndex());
+	if (direction > 0)
+	{
+		for (int match = m_search->Next(line); match >= 0; match = m_search->Next(match))
+		{
+			if ((index = GetViewIndex(match)) >= 0)
+				return true;
+		}
+		if (searched <= last)
+			return false;
+		for (int match = m_search->Next(-1); match >= 0 && match <= line; match = m_search->Next(match))
+		{
+			if ((index = GetViewIndex(match)) >= 0)
+				return true;
+		}
+	}
+	else
+	{
+		if (searched < line)
+			return false;
+		for (int match = m_search->Previous(line); match >= 0; match = m_search->Previous(match))
+		{
+			if ((index = GetViewIndex(match)) >= 0)
+				return true;
+		}
+		if (searched <= last)
+			return false;
+		for (int match = m_search->Previous(last + 1); match >= line; match = m_search->Previous(match))
+		{
+			if ((index = GetViewIndex(match)) >= 0)
+				return true;
+		}
+	}
 	return true;
 }
 
@@ -1667,12 +1903,13 @@ void CLogView::Save(const std::wstring& filename) const
 	std::ofstream fs;
 	OpenLogFile(fs, filename);
 
+	TimestampFormatter formatter;
 	int lines = GetItemCount();
 	for (int i = 0; i < lines; ++i)
 	{
 		int line = m_logLines[i].line;
 		const Message& msg = m_logFile[line];
-		WriteLogFileMessage(fs, msg.time, msg.systemTime, msg.processId, msg.processName, msg.text);
+		WriteLogFileMessage(fs, formatter, msg.time, msg.systemTime, msg.processId, msg.processName, msg.text);
 	}
 
 	fs.close();
@@ -1703,6 +1940,7 @@ std::vector<int> CLogView::GetBookmarks() const
 
 void CLogView::ResetFilters()
 {
+	++m_filterGeneration;
 	for (auto it = m_filter.messageFilters.begin(); it != m_filter.messageFilters.end(); ++it)
 	{
 		if (it->filterType == FilterType::Once)
@@ -1716,8 +1954,12 @@ void CLogView::ResetFilters()
 	m_matchColors.clear();
 }
 
+// the lines of the log are filtered on worker threads in blocks, the view fills in as the blocks are merged in order.
+// Lines added during the pass are kept in m_pendingLines and run through Add() when the pass is done.
 void CLogView::ApplyFilters()
 {
+	m_filterEngine = LogFilterEngine(m_filter);
+	m_processFilterCache.Clear();
 	ResetFilters();
 	ClearSelection();
 
@@ -1725,41 +1967,112 @@ void CLogView::ApplyFilters()
 	SetItemState(focusItem, 0, LVIS_FOCUSED);
 	int focusLine = focusItem < 0 ? -1 : m_logLines[focusItem].line;
 
+	// bookmarks and focus of lines that an interrupted pass did not merge yet are kept
 	auto bookmarks = GetBookmarks();
-	auto itBookmark = bookmarks.begin();
-
-	std::deque<LogLine> logLines;
-//	logLines.reserve(m_logLines.size());
-	int count = m_logFile.Count();
-	int line = m_firstLine;
-	int item = 0;
-	focusItem = -1;
-	while (line < count)
+	if (m_filterPass)
 	{
-		if (IsIncluded(m_logFile[line]))
-		{
-			logLines.emplace_back(LogLine(line));
-			if (itBookmark != bookmarks.end() && *itBookmark == line)
-			{
-				logLines.back().bookmark = true;
-				++itBookmark;
-			}
+		bookmarks.insert(bookmarks.end(), m_filterPassBookmarks.begin() + m_filterPassBookmark, m_filterPassBookmarks.end());
+		std::sort(bookmarks.begin(), bookmarks.end());
+		if (focusItem < 0)
+			focusLine = m_filterPassFocusLine;
+	}
+	CancelFilterPass();
 
-			if (line <= focusLine)
-				focusItem = item;
+	m_filterPassBookmarks.swap(bookmarks);
+	m_filterPassBookmark = 0;
+	m_filterPassFocusLine = focusLine;
+	m_filterPassFocusItem = -1;
+	m_logLines.clear();
+	ResetSearchCount();
+	SetItemCountEx(0, LVSICF_NOSCROLL);
 
-			++item;
-		}
-		++line;
+	size_t begin = std::max<size_t>(m_firstLine, m_logFile.BeginIndex());
+	size_t end = m_logFile.EndIndex();
+	m_filterPass = make_unique<ParallelFilter>(m_logFile, m_filter, begin, end);
+
+	// a small log is filtered at once, that saves the view from flickering
+	if (end - std::min(begin, end) <= 16 * indexedstorage::blockSize)
+		m_filterPass->Wait();
+	else
+		SetTimer(2, 25, nullptr);
+	PollFilterPass();
+}
+
+// -1 when no filter pass is running
+int CLogView::GetFilterProgress() const
+{
+	return m_filterPass ? m_filterPass->Progress() : -1;
+}
+
+void CLogView::CancelFilterPass()
+{
+	if (!m_filterPass)
+		return;
+
+	KillTimer(2);
+	m_filterPass.reset();
+	m_pendingLines.clear();
+}
+
+void CLogView::PollFilterPass()
+{
+	if (!m_filterPass)
+		return;
+
+	if (m_filterPass->Poll([this](const FilteredBlock& block) { MergeFilteredBlock(block); }) > 0)
+	{
+		SetItemCountEx(m_logLines.size(), LVSICF_NOSCROLL);
+		ResetSearchCount();
 	}
+	if (!m_filterPass->Done())
+		return;
+
+	KillTimer(2);
+	m_filterPass.reset();
+	m_filterPassBookmarks.clear();
+	ScrollToIndex(m_filterPassFocusItem, false);
+	SetItemState(m_filterPassFocusItem, LVIS_FOCUSED, LVIS_FOCUSED);
 
-	m_logLines.swap(logLines);
-	SetItemCountEx(m_logLines.size(), LVSICF_NOSCROLL);
-	ScrollToIndex(focusItem, false);
-	SetItemState(focusItem, LVIS_FOCUSED, LVIS_FOCUSED);
+	std::vector<int> lines;
+	lines.swap(m_pendingLines);
+	int beginIndex = static_cast<int>(m_logFile.BeginIndex());
+	for (auto it = lines.begin(); it != lines.end(); ++it)
+	{
+		if (*it >= beginIndex)
+			Add(beginIndex, *it, m_logFile[*it]);
+	}
+	ResetSearchCount();
+	m_dirty = true;
 	EndUpdate();
 }
 
+void CLogView::MergeFilteredBlock(const FilteredBlock& block)
+{
+	// the verdicts are reduced in line order, also of lines that were dropped from the history since the workers filtered them
+	int beginIndex = static_cast<int>(m_logFile.BeginIndex());
+	auto verdict = block.verdicts.begin();
+	for (auto it = block.lines.begin(); it != block.lines.end(); ++it)
+	{
+		int line = it->line;
+		if (it->stateful && !ReduceLogFilterVerdict(m_filter, *verdict++, m_matchColors))
+			continue;
+		if (line < beginIndex)
+			continue;
+
+		m_logLines.push_back(LogLine(line));
+		while (m_filterPassBookmark < m_filterPassBookmarks.size() && m_filterPassBookmarks[m_filterPassBookmark] < line)
+			++m_filterPassBookmark;
+		if (m_filterPassBookmark < m_filterPassBookmarks.size() && m_filterPassBookmarks[m_filterPassBookmark] == line)
+		{
+			m_logLines.back().bookmark = true;
+			++m_filterPassBookmark;
+		}
+
+		if (line <= m_filterPassFocusLine)
+			m_filterPassFocusItem = static_cast<int>(m_logLines.size()) - 1;
+	}
+}
+
 bool FilterSupportsColor(FilterType::type value)
 {
 	switch (value)
@@ -1774,67 +2087,66 @@ bool FilterSupportsColor(FilterType::type value)
 	return false;
 }
 
-std::vector<Filter> MoveHighlighFiltersToFront(std::vector<Filter> filters)
+// the matching color filters in the order they color a line, Highlight filters take precedence over the others,
+// 'offset' is the position of the first filter in 'matched'
+std::vector<size_t> GetColorFilters(const std::vector<Filter>& filters, const boost::dynamic_bitset<>& matched, size_t offset)
 {
-	std::stable_partition(filters.begin(), filters.end(), [](const Filter& f) { return f.filterType == FilterType::Highlight; });
-	return filters;
+	std::vector<size_t> indices;
+	for (size_t i = 0; i < filters.size(); ++i)
+	{
+		if (matched[offset + i] && FilterSupportsColor(filters[i].filterType))
+			indices.push_back(i);
+	}
+	std::stable_partition(indices.begin(), indices.end(), [&filters](size_t i) { return filters[i].filterType == FilterType::Highlight; });
+	return indices;
 }
 
-TextColor CLogView::GetTextColor(const Message& msg) const
+bool CLogView::GetFilterColor(const Message& msg, const LineClassification& classification, TextColor& color) const
 {
-	auto messageFilters = MoveHighlighFiltersToFront(m_filter.messageFilters);
+	auto messageFilters = GetColorFilters(m_filter.messageFilters, classification.matched, 0);
 	for (auto it = messageFilters.begin(); it != messageFilters.end(); ++it)
 	{
-		std::smatch match;
-		if (it->enable && FilterSupportsColor(it->filterType) && std::regex_search(msg.text, match, it->re))
+		const auto& filter = m_filter.messageFilters[*it];
+		if (filter.bgColor == Colors::Auto)
 		{
-			if (it->bgColor == Colors::Auto)
-			{
-				auto itc = m_matchColors.find(MatchKey(match, it->matchType));
-				if (itc != m_matchColors.end())
-					return TextColor(itc->second, Colors::Text);
-			}
-			else
+			std::smatch match;
+			std::regex_search(msg.text, match, filter.pattern->re);
+			auto itc = m_matchColors.find(MatchKey(match, filter.matchType));
+			if (itc != m_matchColors.end())
 			{
-				return TextColor(it->bgColor, it->fgColor);
+				color = TextColor(itc->second, Colors::Text);
+				return true;
 			}
 		}
+		else
+		{
+			color = TextColor(filter.bgColor, filter.fgColor);
+			return true;
+		}
 	}
 
-	auto processFilters = MoveHighlighFiltersToFront(m_filter.processFilters);
-	for (auto it = processFilters.begin(); it != processFilters.end(); ++it)
-	{
-		if (it->enable && FilterSupportsColor(it->filterType) && std::regex_search(msg.processName, it->re))
-			return TextColor(it->bgColor, it->fgColor);
-	}
+	auto processFilters = GetColorFilters(m_filter.processFilters, classification.matched, m_filter.messageFilters.size());
+	if (processFilters.empty())
+		return false;
 
-	return TextColor(m_processColors ? msg.color : Colors::BackGround, Colors::Text);
+	color = TextColor(m_filter.processFilters[processFilters.front()].bgColor, m_filter.processFilters[processFilters.front()].fgColor);
+	return true;
 }
 
-bool CLogView::IsClearMessage(const Message& msg) const
+bool CLogView::IsClearMessage(const LogFilterMatch& match) const
 {
-	using debugviewpp::MatchFilterType;
-	return MatchFilterType(m_filter.messageFilters, FilterType::Clear, msg.text);
+	return match.message.Matched(FilterType::Clear);
 }
 
-bool CLogView::IsBeepMessage(const Message& msg) const
+bool CLogView::IsBeepMessage(const LogFilterMatch& match) const
 {
-	using debugviewpp::MatchFilterType;
-	return MatchFilterType(m_filter.messageFilters, FilterType::Beep, msg.text) || MatchFilterType(m_filter.processFilters, FilterType::Beep, msg.text);
+	return match.Matched(FilterType::Beep);
 }
 
-bool CLogView::IsIncluded(const Message& msg)
+bool CLogView::IsIncluded(const Message& msg, const LogFilterMatch& match)
 {
 	using debugviewpp::IsIncluded;
-	return IsIncluded(m_filter.processFilters, msg.processName, m_matchColors) && IsIncluded(m_filter.messageFilters, msg.text, m_matchColors);
-}
-
-bool CLogView::MatchFilterType(FilterType::type type, const Message& msg) const
-{
-	using debugviewpp::MatchFilterType;
-	return
-		MatchFilterType(m_filter.messageFilters, type, msg.text) ||
-		MatchFilterType(m_filter.processFilters, type, msg.processName);
+	return IsIncluded(m_filter.processFilters, match.process, msg.processName, m_matchColors) && IsIncluded(m_filter.messageFilters, match.message, msg.text, m_matchColors);
 }
 
 } // namespace debugviewpp 
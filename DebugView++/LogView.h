@@ -9,10 +9,17 @@
 
 #include <vector>
 #include <deque>
+#include <memory>
+#include <unordered_map>
+#include <boost/dynamic_bitset.hpp>
 #include "Win32/Window.h"
 #include "Win32/Win32Lib.h"
 #include "CobaltFusion/AtlWinExt.h"
 #include "DebugView++Lib/LogFile.h"
+#include "DebugView++Lib/Conversions.h"
+#include "DebugView++Lib/FilterEngine.h"
+#include "DebugView++Lib/ParallelFilter.h"
+#include "DebugView++Lib/LogSearch.h"
 #include "FilterDlg.h"
 
 namespace fusion {
@@ -48,6 +55,19 @@ struct Highlight
 	TextColor color;
 };
 
+// LineClassification is the filter result of one line, it is computed once per filter generation
+struct LineClassification
+{
+	LineClassification();
+
+	unsigned generation;
+	boost::dynamic_bitset<> matched;	// message filters followed by process filters
+	bool painted;						// color and highlights are computed
+	bool filterColor;					// a filter colors the line, otherwise it has the process or background color
+	TextColor color;
+	std::vector<Highlight> highlights;	// Token filter highlights
+};
+
 struct LogLine
 {
 	explicit LogLine(int line);
@@ -136,6 +156,8 @@ public:
 	int GetFocusLine() const;
 	void SetFocusLine(int line);
 	void Add(int beginIndex, int line, const Message& msg);
+	void ApplyFilters();
+	int GetFilterProgress() const;
 	void BeginUpdate();
 	bool EndUpdate();
 	void ClearSelection();
@@ -157,6 +179,8 @@ public:
 	void SetHighlightText(const std::wstring& text = std::wstring());
 	bool FindNext(const std::wstring& text);
 	bool FindPrevious(const std::wstring& text);
+	int GetSearchMatchCount() const;
+	int GetSearchProgress() const;
 
 	LogFilter GetFilters() const;
 	void SetFilters(const LogFilter& filter);
@@ -249,6 +273,8 @@ private:
 	void DrawItem(CDCHandle dc, int iItem, unsigned iItemState) const;
 	Highlight GetSelectionHighlight(CDCHandle dc, int iItem) const;
 	std::vector<Highlight> GetHighlights(const std::string& text) const;
+	LineClassification& StoreClassification(int line, const LogFilterMatch& match) const;
+	const LineClassification& GetClassification(int line, const Message& msg) const;
 	void DrawBookmark(CDCHandle dc, int iItem) const;
 	void DrawSubItem(CDCHandle dc, int iItem, int iSubItem, const ItemData& data) const;
 
@@ -262,19 +288,37 @@ private:
 	int FindLine(Predicate pred, int direction) const;
 
 	bool Find(const std::string& text, int direction);
+	bool ContinueFind();
+	bool FindSearchMatch(int direction, int& index) const;
+	int GetViewIndex(int line) const;
+	void OnSearchUpdate();
+	void ResetSearchCount();
 	bool FindProcess(int direction);
-	void ApplyFilters();
-	bool IsClearMessage(const Message& msg) const;
-	bool IsBeepMessage(const Message& msg) const;
-	bool IsIncluded(const Message& msg);
-	bool MatchFilterType(FilterType::type type, const Message& msg) const;
-	TextColor GetTextColor(const Message& msg) const;
+	bool IsClearMessage(const LogFilterMatch& match) const;
+	bool IsBeepMessage(const LogFilterMatch& match) const;
+	bool IsIncluded(const Message& msg, const LogFilterMatch& match);
+	bool GetFilterColor(const Message& msg, const LineClassification& classification, TextColor& color) const;
 	void ResetFilters();
+	void CancelFilterPass();
+	void PollFilterPass();
+	void MergeFilteredBlock(const FilteredBlock& block);
 
 	std::wstring m_name;
 	CMainFrame& m_mainFrame;
 	LogFile& m_logFile;
 	LogFilter m_filter;
+	LogFilterEngine m_filterEngine;
+	LogFilterMatch m_filterMatch;
+	FilterCache m_processFilterCache;
+	unsigned m_filterGeneration;
+	mutable std::unordered_map<int, LineClassification> m_classifications;
+	mutable std::deque<int> m_classificationOrder;
+	std::unique_ptr<ParallelFilter> m_filterPass;
+	std::vector<int> m_filterPassBookmarks;
+	size_t m_filterPassBookmark;
+	int m_filterPassFocusLine;
+	int m_filterPassFocusItem;
+	std::vector<int> m_pendingLines;
 	MatchColors m_matchColors;
 	CMyHeaderCtrl m_hdr;
 	std::vector<ColumnInfo> m_columns;
@@ -290,12 +334,18 @@ private:
 	std::function<bool ()> m_track;
 	Win32::HIcon m_hBookmarkIcon;
 	std::wstring m_highlightText;
+	std::unique_ptr<LogSearch> m_search;
+	int m_findDirection;
+	bool m_findNewText;
+	mutable size_t m_searchCount;
+	mutable size_t m_searchCounted;
 	HCURSOR m_hBeamCursor;
 	CPoint m_dragStart;
 	CPoint m_dragEnd;
 	bool m_dragging;
 	int m_scrollX;
 	std::wstring m_dispInfoText;
+	mutable TimestampFormatter m_timestampFormatter;
 };
 
 } // namespace debugviewpp 
@@ -9,6 +9,7 @@
 
 #include <algorithm>
 #include <boost/utility.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/property_tree/ptree.hpp>
@@ -25,6 +26,8 @@
 #include "DebugView++Lib/SocketReader.h"
 #include "DebugView++Lib/FileReader.h"
 #include "DebugView++Lib/FileIO.h"
+#include "DebugView++Lib/Conversions.h"
+#include "DebugView++Lib/MappedLogFile.h"
 #include "DebugView++Lib/LogFilter.h"
 #include "Resource.h"
 #include "RunDlg.h"
@@ -83,6 +86,7 @@ BEGIN_MSG_MAP2(CMainFrame)
 	COMMAND_ID_HANDLER_EX(ID_LOG_PAUSE, OnLogPause)
 	COMMAND_ID_HANDLER_EX(ID_LOG_GLOBAL, OnLogGlobal)
 	COMMAND_ID_HANDLER_EX(ID_LOG_HISTORY, OnLogHistory)
+	COMMAND_ID_HANDLER_EX(ID_LOG_STATISTICS, OnLogStatistics)
 	COMMAND_ID_HANDLER_EX(ID_LOG_DEBUGVIEW_AGENT, OnLogDebugviewAgent)
 	COMMAND_ID_HANDLER_EX(ID_VIEW_FIND, OnViewFind)
 	COMMAND_ID_HANDLER_EX(ID_VIEW_FILTER, OnViewFilter)
@@ -115,13 +119,13 @@ CMainFrame::CMainFrame() :
 	m_findDlg(*this),
 	m_linkViews(false),
 	m_hide(false),
-	m_lineBuffer(7000),
 	m_tryGlobal(HasGlobalDBWinReaderRights()),
 	m_logFileName(L"DebugView++.dblog"),
 	m_txtFileName(L"MessagesInTheCurrentView.dblog"),
 	m_configFileName(L"DebugView++.dbconf"),
 	m_initialPrivateBytes(ProcessInfo::GetPrivateBytes()),
 	m_logfont(GetDefaultLogFont()),
+	m_textIndex(m_logFile),
 	m_logSources(true),
 	m_pLocalReader(nullptr),
 	m_pGlobalReader(nullptr),
@@ -136,7 +140,7 @@ CMainFrame::~CMainFrame()
 
 void CMainFrame::SetLogging()
 {
-	m_logWriter = make_unique<FileWriter>(GetPersonalPath() + L"\\DebugView++ Logfiles\\debugview.dblog", m_logFile);
+	m_logWriter = make_unique<FileWriter>(GetPersonalPath() + L"\\DebugView++ Logfiles\\debugview.dblog", m_logFile, m_flushPolicy);
 }
 
 void CMainFrame::OnException()
@@ -331,6 +335,18 @@ std::wstring FormatDateTime(const FILETIME& fileTime)
 	return FormatDateTime(Win32::FileTimeToSystemTime(Win32::FileTimeToLocalFileTime(fileTime)));
 }
 
+std::wstring FormatStageCounters(const std::wstring& stage, const StageCounters& counters)
+{
+	return wstringbuilder() << stage << L": " << counters.added << L" added, " << counters.dropped << L" dropped, "
+		<< counters.blocked << L" blocked, peak " << counters.peak << L" lines";
+}
+
+OverflowPolicy::type RegGetOverflowPolicy(HKEY hKey, const wchar_t* valueName, OverflowPolicy::type defaultPolicy)
+{
+	DWORD policy = Win32::RegGetDWORDValue(hKey, valueName, defaultPolicy);
+	return policy <= OverflowPolicy::DropNewest ? static_cast<OverflowPolicy::type>(policy) : defaultPolicy;
+}
+
 std::wstring FormatBytes(size_t size)
 {
 	static const wchar_t* units[] = { L"bytes", L"kB", L"MB", L"GB", L"TB", L"PB", L"EB", nullptr };
@@ -351,9 +367,9 @@ std::wstring CMainFrame::GetSelectionInfoText(const std::wstring& label, const S
 		return std::wstring();
 
 	if (selection.count == 1)
-		return label + L": " + FormatDateTime(m_logFile[selection.beginLine].systemTime);
+		return label + L": " + FormatDateTime(m_logFile.GetSystemTime(selection.beginLine));
 
-	double dt = m_logFile[selection.endLine].time - m_logFile[selection.beginLine].time;
+	double dt = m_logFile.GetTime(selection.endLine) - m_logFile.GetTime(selection.beginLine);
 	return wstringbuilder() << label << L": " << FormatDuration(dt) << L" (" << selection.count << " lines)";
 }
 
@@ -362,15 +378,28 @@ SelectionInfo CMainFrame::GetLogFileRange() const
 	if (m_logFile.Empty())
 		return SelectionInfo();
 
-	return SelectionInfo(0, m_logFile.Count() - 1, m_logFile.Count());
+	return SelectionInfo(m_logFile.BeginIndex(), m_logFile.EndIndex() - 1, m_logFile.Count());
 }
 
 void CMainFrame::UpdateStatusBar()
 {
 	auto isearch = GetView().GetHighlightText();
-	std::wstring search = wstringbuilder() << L"Searching: \"" << isearch << L"\"";
+	int matches = GetView().GetSearchMatchCount();
+	int searchProgress = GetView().GetSearchProgress();
+	std::wstring search = wstringbuilder() << L"Searching: \"" << isearch << L"\", " << matches << L" matches";
+	if (searchProgress < 100)
+		search += (wstringbuilder() << L" (" << searchProgress << L"%)").str();
+	int progress = GetView().GetFilterProgress();
+	std::wstring filtering = wstringbuilder() << L"Filtering " << progress << L"%";
+	std::wstring ready = m_pLocalReader ? L"Ready" : L"Paused";
+	size_t sourceDropped = m_logSources.GetSourceCounters().dropped;
+	if (sourceDropped > 0)
+		ready += (wstringbuilder() << L", " << sourceDropped << L" lines dropped by sources").str();
+	size_t bufferDropped = m_logSources.GetLineBufferCounters().dropped;
+	if (bufferDropped > 0)
+		ready += (wstringbuilder() << L", " << bufferDropped << L" lines dropped by the line buffer").str();
 	UISetText(ID_DEFAULT_PANE,
-		isearch.empty() ? (m_pLocalReader ? L"Ready" : L"Paused") : search.c_str());
+		progress >= 0 ? filtering.c_str() : isearch.empty() ? ready.c_str() : search.c_str());
 	UISetText(ID_SELECTION_PANE, GetSelectionInfoText(L"Selected", GetView().GetSelectedRange()).c_str());
 	UISetText(ID_VIEW_PANE, GetSelectionInfoText(L"View", GetView().GetViewRange()).c_str());
 	UISetText(ID_LOGFILE_PANE, GetSelectionInfoText(L"Log", GetLogFileRange()).c_str());
@@ -606,6 +635,18 @@ bool CMainFrame::LoadSettings()
 	SetTitle();
 
 	m_hide = Win32::RegGetDWORDValue(reg, L"Hide", 0) != 0;
+	m_logFile.SetStorageDirectory(Win32::RegGetStringValue(reg, L"StorageDirectory", Win32::GetTempPath().c_str()));
+
+	DWORD flushPolicy = Win32::RegGetDWORDValue(reg, L"FlushPolicy", FlushPolicy::Interval);
+	if (flushPolicy > FlushPolicy::Size)
+		flushPolicy = FlushPolicy::Interval;
+	m_flushPolicy = FlushPolicy(static_cast<FlushPolicy::type>(flushPolicy), Win32::RegGetDWORDValue(reg, L"FlushValue", static_cast<DWORD>(FlushPolicy().value)));
+
+	m_logSources.SetLineBufferPolicy(RegGetOverflowPolicy(reg, L"LineBufferPolicy", m_logSources.GetLineBufferPolicy()));
+	DWORD sourceLimit = Win32::RegGetDWORDValue(reg, L"SourceLimit", static_cast<DWORD>(m_logSources.GetSourceLimit()));
+	m_logSources.SetSourceLimit(std::max<DWORD>(sourceLimit, 1), RegGetOverflowPolicy(reg, L"SourcePolicy", m_logSources.GetSourcePolicy()));
+	DWORD normalizeLimit = Win32::RegGetDWORDValue(reg, L"NormalizeLimit", static_cast<DWORD>(m_logSources.GetNormalizeLimit()));
+	m_logSources.SetNormalizeLimit(std::max<DWORD>(normalizeLimit, 1));
 
 	auto fontName = Win32::RegGetStringValue(reg, L"FontName", L"").substr(0, LF_FACESIZE - 1);
 	int fontSize = Win32::RegGetDWORDValue(reg, L"FontSize", 8);
@@ -668,6 +709,13 @@ void CMainFrame::SaveSettings()
 	reg.SetDWORDValue(L"AutoNewLine", m_logSources.GetAutoNewLine());
 	reg.SetDWORDValue(L"AlwaysOnTop", GetAlwaysOnTop());
 	reg.SetDWORDValue(L"Hide", m_hide);
+	reg.SetStringValue(L"StorageDirectory", m_logFile.GetStorageDirectory().c_str());
+	reg.SetDWORDValue(L"FlushPolicy", m_flushPolicy.policy);
+	reg.SetDWORDValue(L"FlushValue", static_cast<DWORD>(m_flushPolicy.value));
+	reg.SetDWORDValue(L"LineBufferPolicy", m_logSources.GetLineBufferPolicy());
+	reg.SetDWORDValue(L"SourceLimit", static_cast<DWORD>(m_logSources.GetSourceLimit()));
+	reg.SetDWORDValue(L"SourcePolicy", m_logSources.GetSourcePolicy());
+	reg.SetDWORDValue(L"NormalizeLimit", static_cast<DWORD>(m_logSources.GetNormalizeLimit()));
 
 	reg.SetStringValue(L"FontName", m_logfont.lfFaceName);
 	reg.SetDWORDValue(L"FontSize", LogFontSizeToPointSize(m_logfont.lfHeight));
@@ -706,6 +754,11 @@ void CMainFrame::FindPrevious(const std::wstring& text)
 		MessageBeep(MB_ICONASTERISK);
 }
 
+const TrigramIndex& CMainFrame::GetTextIndex() const
+{
+	return m_textIndex;
+}
+
 void CMainFrame::AddFilterView()
 {
 	++m_filterNr;
@@ -799,11 +852,12 @@ void CMainFrame::SaveLogFile(const std::wstring& filename)
 
 	std::ofstream fs;
 	OpenLogFile(fs, filename);
-	int count = m_logFile.Count();
-	for (int i = 0; i < count; ++i)
+	TimestampFormatter formatter;
+	int end = m_logFile.EndIndex();
+	for (int i = m_logFile.BeginIndex(); i < end; ++i)
 	{
 		auto msg = m_logFile[i];
-		WriteLogFileMessage(fs, msg.time, msg.systemTime, msg.processId, msg.processName, msg.text);
+		WriteLogFileMessage(fs, formatter, msg.time, msg.systemTime, msg.processId, msg.processName, msg.text);
 	}
 	fs.close();
 	if (!fs)
@@ -951,14 +1005,26 @@ void CMainFrame::OnFileRun(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/
 
 void CMainFrame::Load(const std::wstring& filename)
 {
+	WIN32_FILE_ATTRIBUTE_DATA fileInfo = { 0 };
+	GetFileAttributesEx(filename.c_str(), GetFileExInfoStandard, &fileInfo);
+	auto name = boost::filesystem::wpath(filename).filename().string();
+
+	// text log files are mapped into memory, only the lines that are viewed or filtered are paged in
+	auto fileType = IdentifyFile(filename);
+	if (!IsBinaryFileType(fileType))
+	{
+		auto file = boost::make_shared<MappedLogFile>(filename, fileType);
+		SetTitle(filename);
+		Load(file, name, fileInfo.ftCreationTime);
+		return;
+	}
+
 	std::ifstream file(filename);
 	if (!file)
 		Win32::ThrowLastError(filename);
 
-	WIN32_FILE_ATTRIBUTE_DATA fileInfo = { 0 };
-	GetFileAttributesEx(filename.c_str(), GetFileExInfoStandard, &fileInfo);
 	SetTitle(filename);
-	Load(file, boost::filesystem::wpath(filename).filename().string(), fileInfo.ftCreationTime);
+	Load(file, name, fileInfo.ftCreationTime);
 }
 
 void CMainFrame::LoadAsync(const std::wstring& filename)
@@ -996,6 +1062,22 @@ void CMainFrame::Load(std::istream& file, const std::string& name, FILETIME file
 		AddMessage(Message(line.time, line.systemTime, line.pid, line.processName, line.message));
 }
 
+void CMainFrame::Load(const boost::shared_ptr<const MappedLogFile>& file, const std::string& name, FILETIME fileTime)
+{
+	Win32::ScopedCursor cursor(::LoadCursor(nullptr, IDC_WAIT));
+
+	Pause();
+	ClearLog();
+
+	m_logFile.Load(file, name, fileTime);
+	if (m_logWriter)
+		m_logWriter->Notify();
+	m_textIndex.Notify();
+	int views = GetViewCount();
+	for (int i = 0; i < views; ++i)
+		GetView(i).ApplyFilters();
+}
+
 void CMainFrame::CapturePipe(HANDLE hPipe)
 {
 	m_logSources.AddPipeReader(Win32::GetParentProcessId(), hPipe);
@@ -1052,6 +1134,7 @@ void CMainFrame::ClearLog()
 {
 	// First Clear LogFile so views reset their m_firstLine:
 	m_logFile.Clear();
+	m_textIndex.Clear();
 	m_logSources.Reset();
 	int views = GetViewCount();
 	for (int i = 0; i < views; ++i)
@@ -1206,6 +1289,21 @@ void CMainFrame::OnLogHistory(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCt
 		m_logFile.SetHistorySize(dlg.GetHistorySize());
 }
 
+void CMainFrame::OnLogStatistics(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/)
+{
+	std::wstring sources = wstringbuilder() << L"Sources (" << m_logSources.GetSourceLimit() << L" lines each, "
+		<< WStr(OverflowPolicyToString(m_logSources.GetSourcePolicy())).str() << L")";
+	std::wstring lineBuffer = wstringbuilder() << L"Line buffer ("
+		<< WStr(OverflowPolicyToString(m_logSources.GetLineBufferPolicy())).str() << L")";
+	std::wstring normalize = wstringbuilder() << L"Normalize (" << m_logSources.GetNormalizeLimit() << L" lines)";
+
+	std::wstring text = wstringbuilder()
+		<< FormatStageCounters(sources, m_logSources.GetSourceCounters()) << L"\n"
+		<< FormatStageCounters(lineBuffer, m_logSources.GetLineBufferCounters()) << L"\n"
+		<< FormatStageCounters(normalize, m_logSources.GetNormalizeCounters());
+	MessageBox(text.c_str(), L"Statistics", MB_ICONINFORMATION | MB_OK);
+}
+
 std::wstring GetExecutePath()
 {
 	using namespace boost;
@@ -1356,9 +1454,12 @@ CLogView& CMainFrame::GetView()
 
 void CMainFrame::AddMessage(const Message& message)
 {
-	int beginIndex = m_logFile.BeginIndex();
 	int index = m_logFile.EndIndex();
 	m_logFile.Add(message);
+	if (m_logWriter)
+		m_logWriter->Notify();
+	m_textIndex.Notify();
+	int beginIndex = m_logFile.BeginIndex();
 	int views = GetViewCount();
 	for (int i = 0; i < views; ++i)
 		GetView(i).Add(beginIndex, index, message);
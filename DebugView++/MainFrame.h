@@ -21,6 +21,7 @@ namespace WTL { using ATL::CString; };
 #include "DebugView++Lib/LineBuffer.h"
 #include "DebugView++Lib/LogSources.h"
 #include "DebugView++Lib/FileWriter.h"
+#include "DebugView++Lib/TrigramIndex.h"
 #include "FindDlg.h"
 #include "RunDlg.h"
 #include "LogView.h"
@@ -30,6 +31,7 @@ namespace debugviewpp {
 
 struct SelectionInfo;
 class DbgviewReader;
+class MappedLogFile;
 
 class CLogViewTabItem : public CTabViewTabItem
 {
@@ -107,9 +109,11 @@ public:
 	void LoadAsync(const std::wstring& fileName);
 	void Load(HANDLE hFile);
 	void Load(std::istream& is, const std::string& name, FILETIME fileTime);
+	void Load(const boost::shared_ptr<const MappedLogFile>& file, const std::string& name, FILETIME fileTime);
 	void CapturePipe(HANDLE hPipe);
 	void FindNext(const std::wstring& text);
 	void FindPrevious(const std::wstring& text);
+	const TrigramIndex& GetTextIndex() const;
 	void OnDropFiles(HDROP hDropInfo);
 
 private:
@@ -185,6 +189,7 @@ private:
 	void OnLogPause(UINT uNotifyCode, int nID, CWindow wndCtl);
 	void OnLogGlobal(UINT uNotifyCode, int nID, CWindow wndCtl);
 	void OnLogHistory(UINT uNotifyCode, int nID, CWindow wndCtl);
+	void OnLogStatistics(UINT uNotifyCode, int nID, CWindow wndCtl);
 	void OnLogDebugviewAgent(UINT uNotifyCode, int nID, CWindow wndCtl);
 	void OnViewFind(UINT uNotifyCode, int nID, CWindow wndCtl);
 	void OnViewFont(UINT uNotifyCode, int nID, CWindow wndCtl);
@@ -203,12 +208,13 @@ private:
 	void AddLogSource(const SourceInfo& info);
 	void CloseView(int i);
 
-	LineBuffer m_lineBuffer;
 	CCommandBarCtrl m_cmdBar;
 	CMultiPaneStatusBarCtrl m_statusBar; // CMultiPaneStatusBarCtrlFlickerFree /  CMultiPaneStatusBarCtrl
 	UINT_PTR m_timer;
 	LogFile m_logFile;
 	std::unique_ptr<FileWriter> m_logWriter;
+	FlushPolicy m_flushPolicy;
+	TrigramIndex m_textIndex;
 	int m_filterNr;
 	CFindDlg m_findDlg;
 	Win32::HFont m_hFont;
@@ -0,0 +1,296 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#include "stdafx.h"
+#include <algorithm>
+#include <cstring>
+#include "DebugView++Lib/CircularLineBuffer.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+namespace {
+
+size_t RoundUpToPowerOfTwo(size_t size)
+{
+	size_t result = 1;
+	while (result < size)
+		result <<= 1;
+	return result;
+}
+
+} // namespace
+
+CircularLineBuffer::CircularLineBuffer(size_t size, OverflowPolicy::type policy) :
+	m_capacity(RoundUpToPowerOfTwo(std::max(size, 2 * (sizeof(Header) + unitSize)))),
+	m_ring(new char[m_capacity]),
+	m_committed(new boost::atomic<size_t>[m_capacity / unitSize]),
+	m_maxTextSize(m_capacity - sizeof(Header)),
+	m_reserved(0),
+	m_read(0),
+	m_count(0),
+	m_added(0),
+	m_peak(0),
+	m_waiting(0),
+	m_dropping(false),
+	m_policy(policy),
+	m_abort(false),
+	m_droppedLines(0),
+	m_lastDropped(Header())
+{
+	for (size_t i = 0; i < m_capacity / unitSize; ++i)
+		m_committed[i].store(0, boost::memory_order_relaxed);
+}
+
+void CircularLineBuffer::Add(double time, FILETIME systemTime, HANDLE handle, const std::string& message, const LogSource* pSource)
+{
+	Write(time, systemTime, handle, 0, std::string(), message, pSource);
+}
+
+void CircularLineBuffer::Add(double time, FILETIME systemTime, DWORD pid, const std::string& processName, const std::string& message, const LogSource* pSource)
+{
+	Write(time, systemTime, nullptr, pid, processName, message, pSource);
+}
+
+void CircularLineBuffer::Write(double time, FILETIME systemTime, HANDLE handle, DWORD pid, const std::string& processName, const std::string& message, const LogSource* pSource)
+{
+	// a line larger than the whole buffer is truncated, it would never fit
+	Header header;
+	header.time = time;
+	header.systemTime = systemTime;
+	header.handle = handle;
+	header.pid = pid;
+	header.pLogSource = pSource;
+	header.processNameSize = std::min(processName.size(), m_maxTextSize);
+	header.messageSize = std::min(message.size(), m_maxTextSize - header.processNameSize);
+	size_t size = (sizeof(Header) + header.processNameSize + header.messageSize + unitSize - 1) & ~(unitSize - 1);
+
+	size_t position;
+	if ((m_dropping.load(boost::memory_order_acquire) || !TryReserve(size, position)) && !Overflow(header, size, position))
+	{
+		// the consumer closes the process handle of a line, a dropped line never gets there
+		if (handle)
+			::CloseHandle(handle);
+		return;
+	}
+
+	CopyIn(position, &header, sizeof(header));
+	CopyIn(position + sizeof(header), processName.data(), header.processNameSize);
+	CopyIn(position + sizeof(header) + header.processNameSize, message.data(), header.messageSize);
+
+	// counted before the record is published, so the consumer never subtracts a line that is not counted yet
+	m_added.fetch_add(1, boost::memory_order_relaxed);
+	size_t count = m_count.fetch_add(1, boost::memory_order_relaxed) + 1;
+	size_t peak = m_peak.load(boost::memory_order_relaxed);
+	while (count > peak && !m_peak.compare_exchange_weak(peak, count, boost::memory_order_relaxed))
+	{
+	}
+
+	Committed(position).store(size, boost::memory_order_release);
+}
+
+bool CircularLineBuffer::TryReserve(size_t size, size_t& position)
+{
+	// m_read is loaded first, it can not pass a position that is loaded later
+	size_t read = m_read.load();
+	position = m_reserved.load(boost::memory_order_relaxed);
+	while (position + size - read <= m_capacity)
+	{
+		if (m_reserved.compare_exchange_weak(position, position + size, boost::memory_order_relaxed))
+			return true;
+	}
+	return false;
+}
+
+// the slow path of Write() when the ring is full or lines are being dropped, returns false when the line is dropped
+bool CircularLineBuffer::Overflow(const Header& header, size_t size, size_t& position)
+{
+	boost::unique_lock<boost::mutex> lock(m_mutex);
+
+	// m_waiting is incremented before the space is checked again, the consumer checks it after it releases space
+	++m_waiting;
+	bool blocked = false;
+	bool reserved = false;
+	while (m_droppedLines == 0 && !reserved)
+	{
+		reserved = TryReserve(size, position);
+		if (reserved)
+			break;
+
+		if (m_policy == OverflowPolicy::Block && !m_abort)
+		{
+			if (!blocked)
+				++m_counters.blocked;
+			blocked = true;
+			m_cond.wait(lock);
+		}
+		else if (m_policy == OverflowPolicy::DropOldest)
+		{
+			// the oldest line can still be copied in by its producer, that does not take long
+			if (!DropOldest())
+				boost::this_thread::yield();
+		}
+		else
+		{
+			break;
+		}
+	}
+	--m_waiting;
+	if (reserved)
+		return true;
+
+	++m_counters.dropped;
+	if (m_policy == OverflowPolicy::DropNewest)
+	{
+		++m_droppedLines;
+		m_lastDropped = header;
+		m_dropping.store(true, boost::memory_order_release);
+	}
+	return false;
+}
+
+// called with m_mutex held, returns false when the oldest line is not published yet
+bool CircularLineBuffer::DropOldest()
+{
+	boost::lock_guard<boost::mutex> lock(m_readMutex);
+	size_t read = m_read.load(boost::memory_order_relaxed);
+	auto& committed = Committed(read);
+	size_t size = committed.load(boost::memory_order_acquire);
+	if (size == 0)
+		return false;
+
+	Header header;
+	CopyOut(read, &header, sizeof(header));
+	if (header.handle)
+		::CloseHandle(header.handle);
+
+	committed.store(0, boost::memory_order_relaxed);
+	m_read.store(read + size);
+	m_count.fetch_sub(1, boost::memory_order_relaxed);
+	++m_counters.dropped;
+	return true;
+}
+
+boost::atomic<size_t>& CircularLineBuffer::Committed(size_t position) const
+{
+	return m_committed[(position & (m_capacity - 1)) / unitSize];
+}
+
+void CircularLineBuffer::CopyIn(size_t position, const void* data, size_t size)
+{
+	size_t offset = position & (m_capacity - 1);
+	size_t size1 = std::min(size, m_capacity - offset);
+	std::memcpy(m_ring.get() + offset, data, size1);
+	std::memcpy(m_ring.get(), static_cast<const char*>(data) + size1, size - size1);
+}
+
+void CircularLineBuffer::CopyOut(size_t position, void* data, size_t size) const
+{
+	size_t offset = position & (m_capacity - 1);
+	size_t size1 = std::min(size, m_capacity - offset);
+	std::memcpy(data, m_ring.get() + offset, size1);
+	std::memcpy(static_cast<char*>(data) + size1, m_ring.get(), size - size1);
+}
+
+void CircularLineBuffer::ReadString(size_t position, std::string& s, size_t size) const
+{
+	s.resize(size);
+	if (size > 0)
+		CopyOut(position, &s[0], size);
+}
+
+Lines CircularLineBuffer::GetLines()
+{
+	Lines lines;
+	{
+		boost::lock_guard<boost::mutex> lock(m_readMutex);
+		lines.reserve(m_count.load(boost::memory_order_relaxed));
+
+		// at most the lines that were reserved before, the batch ends at a line that is still being copied in
+		size_t read = m_read.load(boost::memory_order_relaxed);
+		size_t end = m_reserved.load(boost::memory_order_relaxed);
+		while (read != end)
+		{
+			auto& committed = Committed(read);
+			size_t size = committed.load(boost::memory_order_acquire);
+			if (size == 0)
+				break;
+
+			Header header;
+			CopyOut(read, &header, sizeof(header));
+			lines.push_back(Line(header.time, header.systemTime, header.pid, std::string(), std::string(), header.pLogSource));
+			auto& line = lines.back();
+			line.handle = header.handle;
+			ReadString(read + sizeof(header), line.processName, header.processNameSize);
+			ReadString(read + sizeof(header) + header.processNameSize, line.message, header.messageSize);
+
+			committed.store(0, boost::memory_order_relaxed);
+			read += size;
+			m_read.store(read);
+		}
+		m_count.fetch_sub(lines.size(), boost::memory_order_relaxed);
+	}
+
+	size_t dropped = 0;
+	Header lastDropped = Header();
+	if (m_dropping.load(boost::memory_order_acquire) || m_waiting.load() > 0)
+	{
+		boost::lock_guard<boost::mutex> lock(m_mutex);
+		dropped = m_droppedLines;
+		m_droppedLines = 0;
+		lastDropped = m_lastDropped;
+		m_dropping.store(false, boost::memory_order_relaxed);
+		m_cond.notify_all();
+	}
+
+	// the dropped lines were newer than the lines in this batch
+	if (dropped > 0)
+	{
+		lines.push_back(Line(lastDropped.time, lastDropped.systemTime, 0, "[internal]", GetDroppedLinesMessage(dropped), lastDropped.pLogSource));
+	}
+	return lines;
+}
+
+bool CircularLineBuffer::Empty() const
+{
+	return m_read.load() == m_reserved.load() && !m_dropping.load(boost::memory_order_acquire);
+}
+
+OverflowPolicy::type CircularLineBuffer::GetPolicy() const
+{
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	return m_policy;
+}
+
+void CircularLineBuffer::SetPolicy(OverflowPolicy::type policy)
+{
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	m_policy = policy;
+	m_cond.notify_all();
+}
+
+StageCounters CircularLineBuffer::GetCounters() const
+{
+	StageCounters counters;
+	{
+		boost::lock_guard<boost::mutex> lock(m_mutex);
+		counters = m_counters;
+	}
+	counters.added = m_added.load(boost::memory_order_relaxed);
+	counters.peak = m_peak.load(boost::memory_order_relaxed);
+	return counters;
+}
+
+void CircularLineBuffer::Abort()
+{
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	m_abort = true;
+	m_cond.notify_all();
+}
+
+} // namespace debugviewpp
+} // namespace fusion
@@ -7,6 +7,7 @@
 
 #include "stdafx.h"
 #include <cstdlib>
+#include <cmath>
 #include "DebugView++Lib/Colors.h"
 #include "CobaltFusion/Math.h"
 
@@ -73,5 +74,13 @@ COLORREF GetRandomProcessColor()
 	return GetRandomColor(0.20, 0.95);
 }
 
+COLORREF GetTokenBackColor(size_t index)
+{
+	static const double ratio = (1 + std::sqrt(5.))/2 - 1;
+	// golden ratio steps like GetRandomColor(), from a fixed start
+	double h = std::fmod((index + 1) * ratio, 1.);
+	return HsvToRgb(h, 0.5, 0.95);
+}
+
 } // namespace debugviewpp 
 } // namespace fusion
@@ -6,11 +6,11 @@
 // Repository at: https://github.com/djeedjay/DebugViewPP/
 
 #include "stdafx.h"
-#include <sstream>
-#include <iomanip>
+#include <cmath>
+#include <cstring>
+#include <vector>
 #include "Win32/Utilities.h"
 #include "Win32/Win32Lib.h"
-#include "CobaltFusion/stringbuilder.h"
 #include "DebugView++Lib/Conversions.h"
 
 namespace fusion {
@@ -18,7 +18,8 @@ namespace debugviewpp {
 
 std::string GetTimeText(double time)
 {
-	return stringbuilder() << std::fixed << std::setprecision(6) << time;
+	char buf[TimestampFormatter::offsetSize];
+	return std::string(buf, TimestampFormatter::FormatOffset(time, buf));
 }
 
 std::string GetDateText(const SYSTEMTIME& st)
@@ -61,76 +62,163 @@ SYSTEMTIME GetSystemTime(WORD year, WORD month, WORD day)
 	return st;
 }
 
-USTimeConverter::USTimeConverter() :
-	m_lastFileTime(),
-	m_firstValue(true)
+uint64_t ToUInt64(const FILETIME& ft)
 {
+	return (static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
 }
 
-FILETIME USTimeConverter::USTimeToFiletime(WORD h, WORD m, WORD s, WORD ms)
+FILETIME ToFileTime(uint64_t t)
 {
-	if (m_firstValue)
-	{
-		m_firstValue = false;
-		auto st = GetSystemTime(2000, 1, 1);
-		st.wHour = h;
-		st.wMinute = m;
-		st.wSecond = s;
-		st.wMilliseconds = 0;
-		m_lastFileTime = Win32::SystemTimeToFileTime(st);
-	}
-
-	auto st = Win32::FileTimeToSystemTime(m_lastFileTime);
-	st.wHour = h;
-	st.wMinute = m;
-	st.wSecond = s;
-	st.wMilliseconds = 0;
-	auto ft = Win32::SystemTimeToFileTime(st);
+	FILETIME ft;
+	ft.dwHighDateTime = static_cast<DWORD>(t >> 32);
+	ft.dwLowDateTime = static_cast<DWORD>(t);
+	return ft;
+}
 
-	if (ft < m_lastFileTime) // is ft before m_lastFileTime, then assume it is on the next day.
-	{
-		st.wDay += 1;
-	}
-	m_lastFileTime = Win32::SystemTimeToFileTime(st);
-	return Win32::LocalFileTimeToFileTime(ft); // convert to UTC
+USTimeConverter::USTimeConverter() :
+	m_lastTime(ToUInt64(Win32::SystemTimeToFileTime(GetSystemTime(2000, 1, 1)))),
+	m_utcBias(0)
+{
+	m_utcBias = static_cast<int64_t>(ToUInt64(Win32::LocalFileTimeToFileTime(ToFileTime(m_lastTime))) - m_lastTime);
 }
 
 // read localtime in format "hh:mm:ss tt" (AM/PM postfix)
 bool USTimeConverter::ReadLocalTimeUSRegion(const std::string& text, FILETIME& ft)
 {
-	std::istringstream is(text);
-	WORD h, m, s;
-	char c1, c2, p1, p2;
-	if (!((is >> h >> c1 >> m >> c2 >> s) && c1 == ':' && c2 == ':'))
+	USTime time;
+	if (!ParseTimeOfDay(text, TimeFormat::USRegion, time))
 		return false;
-	if (h == 12) 
-		h = 0;
-
-	if (is >> p1 >> p2 && p1 == 'P' && p2 == 'M')
-		h += 12;
 
-	ft = USTimeToFiletime(h, m, s, 0);
+	ft = Convert(time);
 	return true;
 }
 
 // read localtime in format "hh:mm:ss.ms tt" (AM/PM postfix)
 bool USTimeConverter::ReadLocalTimeUSRegionMs(const std::string& text, FILETIME& ft)
 {
-	std::istringstream is(text);
-
-	WORD h, m, s, ms;
-	char c1, c2, p1, p2, d1;
-	if (!((is >> h >> c1 >> m >> c2 >> s >> d1 >> ms) && c1 == ':' && c2 == ':' && d1 == '.'))
+	USTime time;
+	if (!ParseTimeOfDay(text, TimeFormat::USRegionMs, time))
 		return false;
-	if (h == 12) 
-		h = 0;
-
-	if (is >> p1 >> p2 && p1 == 'P' && p2 == 'M')
-		h += 12;
 
-	ft = USTimeToFiletime(h, m, s, ms);
+	ft = Convert(time);
 	return true;
 }
 
+FILETIME USTimeConverter::Convert(const USTime& time)
+{
+	const uint64_t millisecond = 10000;
+	const uint64_t day = 24 * 60 * 60 * 1000 * millisecond;
+
+	uint64_t timeOfDay = (((time.hour * 60ULL + time.minute) * 60 + time.second) * 1000 + time.milliseconds) * millisecond;
+	uint64_t t = m_lastTime - m_lastTime % day + timeOfDay;
+	if (t < m_lastTime) // is t before the previous time, then assume it is on the next day.
+		t += day;
+	m_lastTime = t;
+	return ToFileTime(t + m_utcBias); // convert to UTC
+}
+
+char* WriteDigits(char* p, unsigned value, int digits)
+{
+	for (int i = digits - 1; i >= 0; --i)
+	{
+		p[i] = static_cast<char>('0' + value % 10);
+		value /= 10;
+	}
+	return p + digits;
+}
+
+TimestampFormatter::TimestampFormatter() :
+	m_second(~0ULL),
+	m_day(~0ULL),
+	m_dateDay(~0ULL)
+{
+	m_text[0] = '\0';
+}
+
+// returns the milliseconds of ft, the time zone bias is a whole number of minutes,
+// so the milliseconds are the same in UTC and local time.
+unsigned TimestampFormatter::Update(const FILETIME& ft)
+{
+	const uint64_t millisecond = 10000;
+	const uint64_t second = 1000 * millisecond;
+
+	auto t = ToUInt64(ft);
+	if (t / second != m_second)
+	{
+		auto local = Win32::FileTimeToLocalFileTime(ft);
+		m_st = Win32::FileTimeToSystemTime(local);
+		sprintf_s(m_text, "%04d/%02d/%02d %02d:%02d:%02d.", m_st.wYear, m_st.wMonth, m_st.wDay, m_st.wHour, m_st.wMinute, m_st.wSecond);
+		m_second = t / second;
+		m_day = ToUInt64(local) / (24 * 60 * 60 * second);
+	}
+	return static_cast<unsigned>(t / millisecond % 1000);
+}
+
+size_t TimestampFormatter::FormatDateTime(const FILETIME& ft, char* buffer)
+{
+	auto ms = Update(ft);
+	std::memcpy(buffer, m_text, dateTimeSize - 3);
+	WriteDigits(buffer + dateTimeSize - 3, ms, 3);
+	return dateTimeSize;
+}
+
+size_t TimestampFormatter::FormatTime(const FILETIME& ft, char* buffer)
+{
+	auto ms = Update(ft);
+	std::memcpy(buffer, m_text + dateTimeSize - timeSize, timeSize - 3);
+	WriteDigits(buffer + timeSize - 3, ms, 3);
+	return timeSize;
+}
+
+size_t TimestampFormatter::FormatOffset(double time, char* buffer)
+{
+	// The fraction of a relative time of a second or more is a multiple of 2^-52, so the microseconds
+	// can be rounded exactly in integer arithmetic, just like sprintf rounds the exact binary value.
+	// Anything else falls back to sprintf.
+	const double scale = 4503599627370496.0; // 2^52
+	unsigned seconds = time >= 0 && time < 1e9 ? static_cast<unsigned>(time) : 0;
+	double fraction = (time - seconds) * scale;
+	if (!(time >= 0 && time < 1e9) || fraction != std::floor(fraction))
+	{
+		int size = _snprintf_s(buffer, offsetSize, _TRUNCATE, "%.06f", time);
+		return size < 0 ? offsetSize - 1 : static_cast<size_t>(size);
+	}
+
+	// fraction * 10^6 / 2^52 = m * 15625 / 2^46, with m split in 32 + 20 bits to stay within 64 bits
+	auto m = static_cast<uint64_t>(fraction);
+	uint64_t high = (m >> 20) * 15625;
+	uint64_t low = (m & 0xFFFFF) * 15625;
+	high += low >> 20;
+	auto us = static_cast<unsigned>(high >> 26);
+	uint64_t remainder = ((high & 0x3FFFFFF) << 20) | (low & 0xFFFFF);
+	if (remainder >= (1ULL << 45))
+		++us;
+	if (us == 1000000)
+	{
+		++seconds;
+		us = 0;
+	}
+
+	int digits = 1;
+	for (auto n = seconds; n >= 10; n /= 10)
+		++digits;
+
+	auto p = WriteDigits(buffer, seconds, digits);
+	*p++ = '.';
+	p = WriteDigits(p, us, 6);
+	return static_cast<size_t>(p - buffer);
+}
+
+const std::string& TimestampFormatter::FormatDate(const FILETIME& ft)
+{
+	Update(ft);
+	if (m_day != m_dateDay)
+	{
+		m_date = GetDateText(m_st);
+		m_dateDay = m_day;
+	}
+	return m_date;
+}
+
 } // namespace debugviewpp 
 } // namespace fusion
@@ -17,7 +17,8 @@ namespace debugviewpp {
 
 DBLogReader::DBLogReader(Timer& timer, ILineBuffer& linebuffer, FileType::type filetype, const std::wstring& filename) : 
 	FileReader(timer, linebuffer, filetype, filename),
-	m_linenumber(0)
+	m_linenumber(0),
+	m_timeFormat(TimeFormat::Unknown)
 {
 }
 
@@ -52,7 +53,7 @@ void DBLogReader::AddLine(const std::string& data)
 	case FileType::AsciiText:
 		return FileReader::AddLine(data);
 	case FileType::Sysinternals:
-		ReadSysInternalsLogFileMessage(data, line, m_converter);
+		ReadSysInternalsLogFileMessage(data, line, m_converter, m_timeFormat);
 		GetRelativeTime(line);
 		break;
 	case FileType::DebugViewPP1:
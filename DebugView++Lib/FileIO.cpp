@@ -8,8 +8,8 @@
 #include "stdafx.h"
 #include <fstream>
 #include <algorithm>
-#include <sstream>
-#include <boost/lexical_cast.hpp>
+#include <stdexcept>
+#include <cstring>
 #include <boost/algorithm/string.hpp>
 #include "Win32/Win32Lib.h"
 #include "Win32/Utilities.h"
@@ -17,6 +17,7 @@
 #include "DebugView++Lib/LogFile.h"
 #include "DebugView++Lib/FileIO.h"
 #include "DebugView++Lib/Conversions.h"
+#include "DebugView++Lib/TimeParser.h"
 
 namespace fusion {
 namespace debugviewpp {
@@ -24,30 +25,46 @@ namespace debugviewpp {
 class TabSplitter
 {
 public:
-	explicit TabSplitter(const std::string& text) :
-		m_it(text.begin()),
-		m_end(text.end())
+	explicit TabSplitter(boost::string_ref text) :
+		m_text(text)
 	{
 	}
 
-	std::string GetNext()
+	boost::string_ref GetNext()
 	{
-		auto it = std::find(m_it, m_end, '\t');
-		std::string s(m_it, it);
-		m_it = it == m_end ? it : it + 1;
+		auto pos = m_text.find('\t');
+		auto s = m_text.substr(0, pos);
+		m_text = pos == boost::string_ref::npos ? boost::string_ref() : m_text.substr(pos + 1);
 		return s;
 	}
 
-	std::string GetTail() const
+	boost::string_ref GetTail() const
 	{
-		return std::string(m_it, m_end);
+		return m_text;
 	}
 
 private:
-	std::string::const_iterator m_it;
-	std::string::const_iterator m_end;
+	boost::string_ref m_text;
 };
 
+bool ParseNumber(boost::string_ref text, DWORD& value)
+{
+	if (text.empty())
+		return false;
+
+	unsigned long long n = 0;
+	for (auto it = text.begin(); it != text.end(); ++it)
+	{
+		if (*it < '0' || *it > '9')
+			return false;
+		n = 10 * n + (*it - '0');
+		if (n > MAXDWORD)
+			return false;
+	}
+	value = static_cast<DWORD>(n);
+	return true;
+}
+
 FILETIME MakeFileTime(uint64_t t)
 {
 	uint32_t mask = ~0U;
@@ -57,26 +74,16 @@ FILETIME MakeFileTime(uint64_t t)
 	return ft;
 }
 
-FILETIME MakeFileTime(const std::string text)
+// a line with an unparsable date keeps its other columns, it gets no system time
+FILETIME MakeFileTime(boost::string_ref text)
 {
-	SYSTEMTIME st = { 0 };
-	std::istringstream is(text);
-	char c1, c2, c3, c4, c5, c6;
-	if (!((is >> st.wYear >> c1 >> st.wMonth >> c2 >> st.wDay >> std::noskipws >> c3 >> st.wHour >> c4 >> st.wMinute >> c5 >> st.wSecond >> c6 >> st.wMilliseconds) 
-		&& c1 == '/' && c2 == '/' && c3 == ' ' && c4 == ':' && c5 == ':' && c6 == '.'))
-	{
-		st = Win32::FileTimeToSystemTime(FILETIME());
-	}
+	SYSTEMTIME st;
+	if (!ParseDateTime(text, st))
+		return FILETIME();
 
 	return Win32::LocalFileTimeToFileTime(Win32::SystemTimeToFileTime(st));
 }
 
-bool ReadTime(const std::string& s, double& time)
-{
-	std::istringstream is(s);
-	return is >> time && is.eof();
-}
-
 bool FileExists(const char *filename)
 {
 	std::ifstream ifile(filename);
@@ -172,53 +179,41 @@ bool IsBinaryFileType(FileType::type filetype)
 	}
 }
 
-// read localtime in format "HH:mm:ss.ms"
-bool ReadLocalTimeMs(const std::string& text, FILETIME& ft)
+std::istream& ReadLogFileMessage(std::istream& is, Line& line)
 {
-	std::istringstream is(text);
-	WORD h, m, s, ms;
-	char c1, c2, d1;
-	if (!((is >> h >> c1 >> m >> c2 >> s >> d1 >> ms) && c1 == ':' && c2 == ':' && d1 == '.'))
-		return false;
-
-	SYSTEMTIME st = Win32::FileTimeToSystemTime(FILETIME());
-	st.wHour = h;
-	st.wMinute = m;
-	st.wSecond = s;
-	st.wMilliseconds = ms;
-	ft = Win32::LocalFileTimeToFileTime(Win32::SystemTimeToFileTime(st));
-	return true;
+	std::string data;
+	if (!std::getline(is, data))
+		return is;
+	if (!ReadLogFileMessage(data, line))
+		is.setstate(std::ios_base::failbit);
+	return is;
 }
 
-// read localtime in format "HH:mm:ss"
-bool ReadLocalTime(const std::string& text, FILETIME& ft)
+bool ReadSysInternalsLogFileMessage(boost::string_ref data, Line& line, USTimeConverter& converter)
 {
-	std::istringstream is(text);
-	WORD h, m, s;
-	char c1, c2;
-	if (!((is >> h >> c1 >> m >> c2 >> s) && c1 == ':' && c2 == ':'))
-		return false;
+	auto format = TimeFormat::Unknown;
+	return ReadSysInternalsLogFileMessage(data, line, converter, format);
+}
 
-	SYSTEMTIME st = Win32::FileTimeToSystemTime(FILETIME());
-	st.wHour = h;
-	st.wMinute = m;
-	st.wSecond = s;
-	st.wMilliseconds = 0;
-	ft = Win32::LocalFileTimeToFileTime(Win32::SystemTimeToFileTime(st));
+bool ReadSysInternalsLogFileMessage(boost::string_ref data, Line& line, USTimeConverter& converter, TimeFormat::type& format)
+{
+	USTime time;
+	if (ParseSysInternalsLogFileMessage(data, line, time, format))
+		line.systemTime = converter.Convert(time);
 	return true;
 }
 
-std::istream& ReadLogFileMessage(std::istream& is, Line& line)
+bool ParseSysInternalsTime(boost::string_ref text, TimeFormat::type format, Line& line, USTime& time)
 {
-	std::string data;
-	if (!std::getline(is, data))
-		return is;
-	if (!ReadLogFileMessage(data, line))
-		is.setstate(std::ios_base::failbit);
-	return is;
+	switch (format)
+	{
+	case TimeFormat::Unknown: return false;
+	case TimeFormat::Relative: return ParseRelativeTime(text, line.time);
+	default: return ParseTimeOfDay(text, format, time);
+	}
 }
 
-bool ReadSysInternalsLogFileMessage(const std::string& data, Line& line, USTimeConverter& converter)
+bool ParseSysInternalsLogFileMessage(boost::string_ref data, Line& line, USTime& time, TimeFormat::type& format)
 {
 	TabSplitter split(data);
 	auto col1 = split.GetNext();
@@ -228,38 +223,50 @@ bool ReadSysInternalsLogFileMessage(const std::string& data, Line& line, USTimeC
 	// depending on regional settings Sysinternals debugview logs time differently.
 	// we support the four most common formats
 	// 'hh:MM:SS.mmm tt', 'hh:MM:SS tt', 'HH:MM:SS.mmm' and 'HH:MM:SS' 
-	if (!converter.ReadLocalTimeUSRegionMs(col2,line.systemTime))			// try hh:MM:SS.mmm tt
-		if (!converter.ReadLocalTimeUSRegion(col2,line.systemTime))		// try hh:MM:SS tt
-			if (!ReadLocalTimeMs(col2, line.systemTime))		// try HH:MM:SS.mmm
-				if (!ReadLocalTime(col2, line.systemTime))      // try HH:MM:SS
-					ReadTime(col2, line.time);					// otherwise assume relative time: S.mmmmmm
+	// otherwise we assume relative time: S.mmmmmm
+	// the format of the file is detected on its first line, only a line that does not match it is detected again.
+	auto lineFormat = format;
+	if (!ParseSysInternalsTime(col2, lineFormat, line, time))
+	{
+		lineFormat = DetectTimeFormat(col2);
+		ParseSysInternalsTime(col2, lineFormat, line, time);
+		if (format == TimeFormat::Unknown)
+			format = lineFormat;
+	}
+	bool timeOfDay = lineFormat != TimeFormat::Unknown && lineFormat != TimeFormat::Relative;
 
 	if (!col3.empty() && col3[0] == '[')						// messages from processes are preceeded by [pid], but kernel messages do not have a prefix
 	{
 		line.processName = "[unavailable]";
-		std::istringstream is3(col3);
-		char c1, c2, c3;
-		if (is3 >> std::noskipws >> c1 >> line.pid >> c2 >> c3 && c1 == '[' && c2 == ']' && c3 == ' ' && std::getline(is3, line.message))
-			return true;
+		auto end = col3.find("] ");
+		if (end != boost::string_ref::npos && ParseNumber(col3.substr(1, end - 1), line.pid))
+		{
+			line.message.assign(col3.begin() + end + 2, col3.end());
+			return timeOfDay;
+		}
 	}
 	else
 	{
 		line.processName = "[kernel]";
 	}
-	line.message = split.GetTail();
-	return true;
+	line.message.assign(col3.begin(), col3.end());
+	return timeOfDay;
 }
 
-bool ReadLogFileMessage(const std::string& data, Line& line)
+bool ReadLogFileMessage(boost::string_ref data, Line& line)
 {
 	try
 	{
 		TabSplitter split(data);
-		line.time = boost::lexical_cast<double>(split.GetNext());
+		if (!ParseRelativeTime(split.GetNext(), line.time))
+			throw std::runtime_error("invalid relative time");
 		line.systemTime = MakeFileTime(split.GetNext());
-		line.pid = boost::lexical_cast<DWORD>(split.GetNext());
-		line.processName = split.GetNext();
-		line.message = split.GetTail();
+		if (!ParseNumber(split.GetNext(), line.pid))
+			throw std::runtime_error("invalid process id");
+		auto processName = split.GetNext();
+		line.processName.assign(processName.begin(), processName.end());
+		auto message = split.GetTail();
+		line.message.assign(message.begin(), message.end());
 	}
 	catch (std::exception& ex)
 	{
@@ -288,20 +295,55 @@ void OpenLogFile(std::ofstream& ofstream, const std::wstring& filename, OpenMode
 
 std::string GetOffsetText(double time)
 {
-	char buf[32];
-	sprintf_s(buf, "%.06f", time);
-	return buf;
+	char buf[TimestampFormatter::offsetSize];
+	return std::string(buf, TimestampFormatter::FormatOffset(time, buf));
+}
+
+const size_t logFileColumnsSize = TimestampFormatter::offsetSize + TimestampFormatter::dateTimeSize + 16;
+
+// format the columns before the process name
+size_t FormatLogFileColumns(char* buffer, TimestampFormatter& formatter, double time, FILETIME filetime, DWORD pid)
+{
+	size_t size = TimestampFormatter::FormatOffset(time, buffer);
+	buffer[size++] = '\t';
+	size += formatter.FormatDateTime(filetime, buffer + size);
+	buffer[size++] = '\t';
+	_ultoa_s(pid, buffer + size, logFileColumnsSize - size, 10);
+	size += std::strlen(buffer + size);
+	buffer[size++] = '\t';
+	return size;
+}
+
+size_t GetTrimmedSize(const std::string& message)
+{
+	auto end = message.find_last_not_of(" \r\n\t");
+	return end == std::string::npos ? 0 : end + 1;
+}
+
+void WriteLogFileMessage(std::ofstream& ofstream, double time, FILETIME filetime, DWORD pid, const std::string& processName, const std::string& message)
+{
+	TimestampFormatter formatter;
+	WriteLogFileMessage(ofstream, formatter, time, filetime, pid, processName, message);
+}
+
+void WriteLogFileMessage(std::ofstream& ofstream, TimestampFormatter& formatter, double time, FILETIME filetime, DWORD pid, const std::string& processName, const std::string& message)
+{
+	char columns[logFileColumnsSize];
+	ofstream.write(columns, FormatLogFileColumns(columns, formatter, time, filetime, pid));
+	ofstream.write(processName.data(), processName.size());
+	ofstream.put('\t');
+	ofstream.write(message.data(), GetTrimmedSize(message));
+	ofstream.put('\n');
 }
 
-void WriteLogFileMessage(std::ofstream& ofstream, double time, FILETIME filetime, DWORD pid, const std::string& processName, std::string message)
+void AppendLogFileMessage(std::vector<char>& buffer, TimestampFormatter& formatter, double time, FILETIME filetime, DWORD pid, const std::string& processName, const std::string& message)
 {
-	boost::trim_right_if(message, boost::is_any_of(" \r\n\t")); 
-	ofstream <<
-		GetOffsetText(time) << "\t" <<
-		GetDateTimeText(filetime) << "\t"<<
-		pid << "\t" <<
-		processName << "\t" <<
-		message << "\n";
+	char columns[logFileColumnsSize];
+	buffer.insert(buffer.end(), columns, columns + FormatLogFileColumns(columns, formatter, time, filetime, pid));
+	buffer.insert(buffer.end(), processName.begin(), processName.end());
+	buffer.push_back('\t');
+	buffer.insert(buffer.end(), message.begin(), message.begin() + GetTrimmedSize(message));
+	buffer.push_back('\n');
 }
 
 } // namespace debugviewpp 
@@ -6,6 +6,8 @@
 // Repository at: https://github.com/djeedjay/DebugViewPP/
 
 #include "stdafx.h"
+#include <algorithm>
+#include <stdexcept>
 #include "DebugView++Lib/LogFile.h"
 #include "DebugView++Lib/FileIO.h"
 #include "DebugView++Lib/FileWriter.h"
@@ -13,29 +15,111 @@
 namespace fusion {
 namespace debugviewpp {
 
-FileWriter::FileWriter(const std::wstring& filename, LogFile& logfile) :
-	m_logfile(logfile)
+FileWriter::FileWriter(const std::wstring& filename, LogFile& logfile, const FlushPolicy& flushPolicy) :
+	m_flushPolicy(flushPolicy),
+	m_logfile(logfile),
+	m_pending(true),
+	m_stop(false)
 {
 	OpenLogFile(m_ofstream, filename, OpenMode::Append);
+	// m_buffer is the only buffer, so a flush is one write to the file.
+	// basic_filebuf::open() installs its own buffer, so this must follow the open and precede any output
+	m_ofstream.rdbuf()->pubsetbuf(nullptr, 0);
+	m_buffer.reserve(bufferSize + 64 * 1024);
 	m_thread = boost::thread(&FileWriter::Run, this);
 }
 
+FileWriter::~FileWriter()
+{
+	{
+		boost::lock_guard<boost::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_cond.notify_one();
+	m_thread.join();
+}
+
+void FileWriter::Notify()
+{
+	// only the first Notify() after the writer took the pending lines has to wake it up
+	if (m_pending.exchange(true))
+		return;
+
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	m_cond.notify_one();
+}
+
 void FileWriter::Run()
 {
-	//todo: we need locking on Logfile, think of ClearLog() 
-	// also, reading the .dblog file does not work correctly
+	// todo: reading the .dblog file does not work correctly
 	size_t writeIndex = 0;
+	boost::chrono::steady_clock::time_point flushTime;
 	for (;;)
 	{
-		while (writeIndex < m_logfile.Count())
+		bool stop;
+		{
+			boost::unique_lock<boost::mutex> lock(m_mutex);
+			while (!m_stop && !m_pending.exchange(false))
+			{
+				if (m_buffer.empty() || m_flushPolicy.policy != FlushPolicy::Interval)
+					m_cond.wait(lock);
+				else if (m_cond.wait_until(lock, flushTime) == boost::cv_status::timeout)
+					break;
+			}
+			stop = m_stop;
+		}
+
+		bool empty = m_buffer.empty();
+		WriteLines(writeIndex);
+		if (empty && !m_buffer.empty())
+			flushTime = boost::chrono::steady_clock::now() + boost::chrono::milliseconds(m_flushPolicy.value);
+
+		if (stop ||
+			m_flushPolicy.policy == FlushPolicy::EveryBatch ||
+			(m_flushPolicy.policy == FlushPolicy::Interval && boost::chrono::steady_clock::now() >= flushTime) ||
+			(m_flushPolicy.policy == FlushPolicy::Size && m_buffer.size() >= m_flushPolicy.value))
+			Flush();
+
+		if (stop)
+			break;
+	}
+}
+
+void FileWriter::WriteLines(size_t& writeIndex)
+{
+	// LogFile can be read concurrently, a Clear() shows up as an EndIndex() below writeIndex
+	// or as an out_of_range on a line that was just cleared or dropped from the history
+	if (writeIndex > m_logfile.EndIndex())
+		writeIndex = 0;
+	writeIndex = std::max(writeIndex, m_logfile.BeginIndex());
+
+	try
+	{
+		auto endIndex = m_logfile.EndIndex();
+		while (writeIndex < endIndex)
 		{
 			auto msg = m_logfile[writeIndex];
 			++writeIndex;
-			WriteLogFileMessage(m_ofstream, msg.time, msg.systemTime, msg.processId, msg.processName, msg.text);
+			AppendLogFileMessage(m_buffer, m_formatter, msg.time, msg.systemTime, msg.processId, msg.processName, msg.text);
+			if (m_buffer.size() >= bufferSize)
+				Flush();
 		}
-		m_ofstream.flush();
-		boost::this_thread::sleep_for(boost::chrono::seconds(1));
 	}
+	catch (std::out_of_range&)
+	{
+		if (writeIndex >= m_logfile.EndIndex())
+			writeIndex = 0;
+	}
+}
+
+void FileWriter::Flush()
+{
+	if (m_buffer.empty())
+		return;
+
+	m_ofstream.write(m_buffer.data(), m_buffer.size());
+	m_ofstream.flush();
+	m_buffer.clear();
 }
 
 } // namespace debugviewpp 
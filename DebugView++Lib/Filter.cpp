@@ -6,7 +6,11 @@
 // Repository at: https://github.com/djeedjay/DebugViewPP/
 
 #include "stdafx.h"
+#include <map>
+#include <algorithm>
 #include <boost/algorithm/string/case_conv.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/thread.hpp>
 #include "Win32/Registry.h"
 #include "CobaltFusion/stringbuilder.h"
 #include "DebugView++Lib/Colors.h"
@@ -35,7 +39,49 @@ std::string MatchKey(const std::smatch& match, MatchType::type matchType)
 	}
 }
 
+FilterPattern::FilterPattern(const std::string& text, MatchType::type matchType) :
+	re(MakePattern(matchType, text), std::regex_constants::icase | std::regex_constants::optimize),
+	literal(text, matchType)
+{
+}
+
+namespace {
+
+// namespace scope, function local statics are not initialized thread safe by VS2010
+boost::mutex patternsMutex;
+std::map<std::pair<std::string, MatchType::type>, boost::weak_ptr<const FilterPattern>> patterns;
+size_t pruneSize = 64;
+
+} // namespace
+
+boost::shared_ptr<const FilterPattern> GetFilterPattern(const std::string& text, MatchType::type matchType)
+{
+	boost::lock_guard<boost::mutex> lock(patternsMutex);
+	auto& entry = patterns[std::make_pair(text, matchType)];
+	auto pattern = entry.lock();
+	if (!pattern)
+	{
+		pattern.reset(new FilterPattern(text, matchType));
+		entry = pattern;
+	}
+
+	// the entries of patterns that are no longer used are dropped each time the cache doubled in size
+	if (patterns.size() >= pruneSize)
+	{
+		for (auto it = patterns.begin(); it != patterns.end(); )
+		{
+			if (it->second.expired())
+				it = patterns.erase(it);
+			else
+				++it;
+		}
+		pruneSize = std::max<size_t>(64, 2 * patterns.size());
+	}
+	return pattern;
+}
+
 Filter::Filter() :
+	pattern(GetFilterPattern(std::string(), MatchType::Simple)),
 	matchType(MatchType::Simple),
 	filterType(FilterType::Include),
 	bgColor(RGB(255, 255, 255)),
@@ -46,7 +92,7 @@ Filter::Filter() :
 }
 
 Filter::Filter(const std::string& text, MatchType::type matchType, FilterType::type filterType, COLORREF bgColor, COLORREF fgColor, bool enable, bool matched) :
-	text(text), re(MakePattern(matchType, text), std::regex_constants::icase | std::regex_constants::optimize), matchType(matchType), filterType(filterType), bgColor(bgColor), fgColor(fgColor), enable(enable), matched(matched)
+	text(text), pattern(GetFilterPattern(text, matchType)), matchType(matchType), filterType(filterType), bgColor(bgColor), fgColor(fgColor), enable(enable), matched(matched)
 {
 }
 
@@ -96,6 +142,44 @@ void LoadFilterSettings(std::vector<Filter>& filters, CRegKey& reg)
 	}
 }
 
+bool IsMatch(const Filter& filter, const std::string& text)
+{
+	if (filter.pattern->literal.IsLiteral())
+		return filter.pattern->literal.Search(text);
+	return std::regex_search(text, filter.pattern->re);
+}
+
+void GetMatchKeys(const Filter& filter, const std::string& text, std::vector<std::string>& keys)
+{
+	// all matches of a Simple filter have the same key
+	if (filter.pattern->literal.IsSimple())
+	{
+		if (filter.pattern->literal.Search(text))
+			keys.push_back(filter.pattern->literal.Literal());
+		return;
+	}
+
+	std::sregex_iterator begin(text.begin(), text.end(), filter.pattern->re), end;
+	for (auto tok = begin; tok != end; ++tok)
+		keys.push_back(MatchKey(*tok, filter.matchType));
+}
+
+void AddMatchColors(const Filter& filter, const std::string& text, MatchColors& matchColors)
+{
+	std::vector<std::string> keys;
+	GetMatchKeys(filter, text, keys);
+	AddMatchColors(keys, matchColors);
+}
+
+void AddMatchColors(const std::vector<std::string>& keys, MatchColors& matchColors)
+{
+	for (auto it = keys.begin(); it != keys.end(); ++it)
+	{
+		if (matchColors.find(*it) == matchColors.end())
+			matchColors.emplace(std::make_pair(*it, GetTokenBackColor(matchColors.size())));
+	}
+}
+
 bool IsIncluded(std::vector<Filter>& filters, const std::string& text, MatchColors& matchColors)
 {
 	for (auto it = filters.begin(); it != filters.end(); ++it)
@@ -103,7 +187,7 @@ bool IsIncluded(std::vector<Filter>& filters, const std::string& text, MatchColo
 		if (!it->enable)
 			continue;
 
-		if (it->filterType == FilterType::Exclude && std::regex_search(text, it->re))
+		if (it->filterType == FilterType::Exclude && IsMatch(*it, text))
 			return false;
 	}
 
@@ -115,23 +199,15 @@ bool IsIncluded(std::vector<Filter>& filters, const std::string& text, MatchColo
 			continue;
 
 		if (it->bgColor == Colors::Auto)
-		{
-			std::sregex_iterator begin(text.begin(), text.end(), it->re), end;
-			for (auto tok = begin; tok != end; ++tok)
-			{
-				auto key = MatchKey(*tok, it->matchType);
-				if (matchColors.find(key) == matchColors.end())
-					matchColors.emplace(std::make_pair(key, GetRandomBackColor()));
-			}
-		}
+			AddMatchColors(*it, text, matchColors);
 
 		if (it->filterType == FilterType::Include)
 		{
 			includeFilterPresent = true;
-			included |= std::regex_search(text, it->re);
+			included |= IsMatch(*it, text);
 		}
 
-		if (it->filterType == FilterType::Once && std::regex_search(text, it->re))
+		if (it->filterType == FilterType::Once && IsMatch(*it, text))
 		{
 			included |= !it->matched;
 			it->matched = true;
@@ -145,7 +221,7 @@ bool MatchFilterType(const std::vector<Filter>& filters, FilterType::type type,
 {
 	for (auto it = filters.begin(); it != filters.end(); ++it)
 	{
-		if (it->enable && it->filterType == type && std::regex_search(text, it->re))
+		if (it->enable && it->filterType == type && IsMatch(*it, text))
 			return true;
 	}
 
@@ -0,0 +1,553 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#include "stdafx.h"
+#include <cassert>
+#include <algorithm>
+#include <deque>
+#include "DebugView++Lib/Colors.h"
+#include "DebugView++Lib/FilterEngine.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+namespace {
+
+char Fold(char c)
+{
+	return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+bool IsAscii(char c)
+{
+	return static_cast<unsigned char>(c) < 0x80;
+}
+
+bool IsAlphaNumeric(char c)
+{
+	return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+// LongestRun keeps the longest run of consecutive required characters,
+// non-ASCII characters end a run because std::regex::icase may fold them depending on the locale
+class LongestRun
+{
+public:
+	void Append(char c)
+	{
+		if (IsAscii(c))
+			m_run += Fold(c);
+		else
+			End();
+	}
+
+	// the last character turned out to be optional
+	void Drop()
+	{
+		if (!m_run.empty())
+			m_run.erase(m_run.size() - 1);
+	}
+
+	void End()
+	{
+		if (m_run.size() > m_best.size())
+			m_best = m_run;
+		m_run.clear();
+	}
+
+	std::string Get()
+	{
+		End();
+		return m_best;
+	}
+
+private:
+	std::string m_run;
+	std::string m_best;
+};
+
+size_t SkipClass(const std::string& text, size_t i)
+{
+	++i;
+	if (i < text.size() && text[i] == '^')
+		++i;
+	if (i < text.size() && text[i] == ']')
+		++i;
+	while (i < text.size() && text[i] != ']')
+		i += text[i] == '\\' ? 2 : 1;
+	return std::min(i + 1, text.size());
+}
+
+size_t SkipGroup(const std::string& text, size_t i)
+{
+	int depth = 0;
+	while (i < text.size())
+	{
+		switch (text[i])
+		{
+		case '\\': i += 2; break;
+		case '[': i = SkipClass(text, i); break;
+		case '(': ++depth; ++i; break;
+		case ')': ++i; if (--depth == 0) return i; break;
+		default: ++i; break;
+		}
+	}
+	return text.size();
+}
+
+size_t SkipQuantifier(const std::string& text, size_t i)
+{
+	if (text[i] == '{')
+		i = std::min(text.find('}', i), text.size());
+	++i;
+	if (i < text.size() && text[i] == '?')
+		++i;
+	return i;
+}
+
+size_t SkipEscape(const std::string& text, size_t i)
+{
+	switch (text[i + 1])
+	{
+	case 'x': return i + 4;
+	case 'u': return i + 6;
+	case 'c': return i + 3;
+	}
+	i += 2;
+	while (i < text.size() && text[i] >= '0' && text[i] <= '9')
+		++i;
+	return i;
+}
+
+// conservative: alternations are not analyzed, groups, classes and escapes other than
+// escaped punctuation end a literal run, a quantifier makes the character before it optional
+std::string RegexLiteral(const std::string& text)
+{
+	if (text.find('|') != std::string::npos)
+		return std::string();
+
+	LongestRun run;
+	size_t i = 0;
+	while (i < text.size())
+	{
+		switch (text[i])
+		{
+		case '\\':
+			if (i + 1 < text.size() && !IsAlphaNumeric(text[i + 1]))
+			{
+				run.Append(text[i + 1]);
+				i += 2;
+			}
+			else
+			{
+				run.End();
+				i = i + 1 < text.size() ? SkipEscape(text, i) : text.size();
+			}
+			break;
+		case '[':
+			run.End();
+			i = SkipClass(text, i);
+			break;
+		case '(':
+			run.End();
+			i = SkipGroup(text, i);
+			break;
+		case '*':
+		case '?':
+		case '{':
+			run.Drop();
+			run.End();
+			i = SkipQuantifier(text, i);
+			break;
+		case '+':
+			run.End();
+			i = SkipQuantifier(text, i);
+			break;
+		case '.':
+		case '^':
+		case '$':
+		case ')':
+			run.End();
+			++i;
+			break;
+		default:
+			run.Append(text[i]);
+			++i;
+			break;
+		}
+	}
+	return run.Get();
+}
+
+} // namespace
+
+MultiLiteralMatcher::MultiLiteralMatcher() :
+	m_classes(1)
+{
+	std::fill(m_class, m_class + 256, 0);
+}
+
+void MultiLiteralMatcher::Add(const std::string& literal, size_t id)
+{
+	if (literal.empty())
+		return;
+
+	std::string folded(literal);
+	std::transform(folded.begin(), folded.end(), folded.begin(), Fold);
+	m_literals.push_back(std::make_pair(folded, id));
+}
+
+bool MultiLiteralMatcher::Empty() const
+{
+	return m_literals.empty();
+}
+
+void MultiLiteralMatcher::Compile()
+{
+	// one character class per distinct character in the literals, class 0 for all other characters
+	std::fill(m_class, m_class + 256, 0);
+	m_classes = 1;
+	for (auto it = m_literals.begin(); it != m_literals.end(); ++it)
+	{
+		for (auto c = it->first.begin(); c != it->first.end(); ++c)
+		{
+			auto& cls = m_class[static_cast<unsigned char>(*c)];
+			if (cls == 0)
+				cls = static_cast<unsigned char>(m_classes++);
+		}
+	}
+	for (int c = 'A'; c <= 'Z'; ++c)
+		m_class[c] = m_class[c - 'A' + 'a'];
+
+	// trie of the literals, -1 is a missing edge
+	std::vector<std::vector<size_t>> outputs(1);
+	m_next.assign(m_classes, -1);
+	for (auto it = m_literals.begin(); it != m_literals.end(); ++it)
+	{
+		size_t state = 0;
+		for (auto c = it->first.begin(); c != it->first.end(); ++c)
+		{
+			size_t index = state * m_classes + m_class[static_cast<unsigned char>(*c)];
+			if (m_next[index] < 0)
+			{
+				m_next[index] = static_cast<int>(outputs.size());
+				outputs.push_back(std::vector<size_t>());
+				m_next.resize(outputs.size() * m_classes, -1);
+			}
+			state = m_next[index];
+		}
+		outputs[state].push_back(it->second);
+	}
+
+	// breadth first, replace missing edges by the edge of the failure state and inherit its outputs
+	std::vector<int> fail(outputs.size(), 0);
+	std::deque<int> queue;
+	for (size_t cls = 0; cls < m_classes; ++cls)
+	{
+		if (m_next[cls] < 0)
+			m_next[cls] = 0;
+		else
+			queue.push_back(m_next[cls]);
+	}
+	while (!queue.empty())
+	{
+		int state = queue.front();
+		queue.pop_front();
+		auto& failOutputs = outputs[fail[state]];
+		outputs[state].insert(outputs[state].end(), failOutputs.begin(), failOutputs.end());
+
+		for (size_t cls = 0; cls < m_classes; ++cls)
+		{
+			int& next = m_next[state * m_classes + cls];
+			int failNext = m_next[fail[state] * m_classes + cls];
+			if (next < 0)
+			{
+				next = failNext;
+			}
+			else
+			{
+				fail[next] = failNext;
+				queue.push_back(next);
+			}
+		}
+	}
+
+	m_outputBegin.assign(1, 0);
+	m_outputs.clear();
+	for (auto it = outputs.begin(); it != outputs.end(); ++it)
+	{
+		m_outputs.insert(m_outputs.end(), it->begin(), it->end());
+		m_outputBegin.push_back(m_outputs.size());
+	}
+}
+
+void MultiLiteralMatcher::Find(boost::string_ref text, std::vector<unsigned char>& found) const
+{
+	if (m_literals.empty())
+		return;
+
+	const int* next = m_next.data();
+	const size_t* outputBegin = m_outputBegin.data();
+	size_t state = 0;
+	for (auto it = text.begin(); it != text.end(); ++it)
+	{
+		state = next[state * m_classes + m_class[static_cast<unsigned char>(*it)]];
+		for (size_t i = outputBegin[state]; i != outputBegin[state + 1]; ++i)
+			found[m_outputs[i]] = 1;
+	}
+}
+
+std::string RequiredLiteral(const std::string& text, MatchType::type matchType, bool& exact)
+{
+	exact = false;
+	LongestRun run;
+	switch (matchType)
+	{
+	case MatchType::Simple:
+		exact = std::find_if(text.begin(), text.end(), [](char c) { return !IsAscii(c); }) == text.end();
+		for (auto it = text.begin(); it != text.end(); ++it)
+			run.Append(*it);
+		return run.Get();
+	case MatchType::Wildcard:
+		for (auto it = text.begin(); it != text.end(); ++it)
+		{
+			if (*it == '*' || *it == '?')
+				run.End();
+			else
+				run.Append(*it);
+		}
+		return run.Get();
+	case MatchType::Regex:
+	case MatchType::RegexGroups:
+		return RegexLiteral(text);
+	default: assert(!"Unexpected MatchType"); break;
+	}
+	return std::string();
+}
+
+FilterMatch::FilterMatch() :
+	types(0)
+{
+}
+
+bool FilterMatch::Matched(FilterType::type type) const
+{
+	return (types & (1 << type)) != 0;
+}
+
+void FilterCache::Clear()
+{
+	m_evaluated.clear();
+	m_matched.clear();
+}
+
+bool FilterCache::Contains(size_t id) const
+{
+	return id < m_evaluated.size() && m_evaluated[id];
+}
+
+void FilterCache::Store(size_t id, const FilterMatch& match)
+{
+	if (id >= m_evaluated.size())
+	{
+		size_t size = std::max(2 * m_evaluated.size(), id + 1);
+		m_evaluated.resize(size);
+		m_matched.resize(match.filters.size());
+		for (auto it = m_matched.begin(); it != m_matched.end(); ++it)
+			it->resize(size);
+	}
+
+	m_evaluated.set(id);
+	for (size_t i = 0; i < m_matched.size(); ++i)
+		m_matched[i].set(id, match.filters[i] != 0);
+}
+
+void FilterCache::Load(const std::vector<Filter>& filters, size_t id, FilterMatch& match) const
+{
+	assert(filters.size() == m_matched.size());
+
+	match.filters.resize(filters.size());
+	match.types = 0;
+	for (size_t i = 0; i < filters.size(); ++i)
+	{
+		bool matched = m_matched[i][id];
+		match.filters[i] = matched;
+		if (matched)
+			match.types |= 1 << filters[i].filterType;
+	}
+}
+
+FilterEngine::FilterEngine()
+{
+}
+
+FilterEngine::FilterEngine(const std::vector<Filter>& filters) :
+	m_programs(filters.size())
+{
+	for (size_t i = 0; i < filters.size(); ++i)
+	{
+		auto literal = RequiredLiteral(filters[i].text, filters[i].matchType, m_programs[i].exact);
+		m_programs[i].literal = !literal.empty();
+		m_literals.Add(literal, i);
+	}
+	m_literals.Compile();
+}
+
+void FilterEngine::Match(const std::vector<Filter>& filters, const std::string& text, FilterMatch& match) const
+{
+	assert(filters.size() == m_programs.size());
+
+	match.filters.assign(filters.size(), 0);
+	match.types = 0;
+	m_literals.Find(text, match.filters);
+	for (size_t i = 0; i < filters.size(); ++i)
+	{
+		const auto& filter = filters[i];
+		const auto& program = m_programs[i];
+		bool matched = filter.enable &&
+			(match.filters[i] || !program.literal) &&
+			(program.exact || IsMatch(filter, text));
+		match.filters[i] = matched;
+		if (matched)
+			match.types |= 1 << filter.filterType;
+	}
+}
+
+void FilterEngine::Match(const std::vector<Filter>& filters, FilterCache& cache, size_t id, const std::string& text, FilterMatch& match) const
+{
+	if (cache.Contains(id))
+	{
+		cache.Load(filters, id, match);
+		return;
+	}
+
+	Match(filters, text, match);
+	cache.Store(id, match);
+}
+
+bool LogFilterMatch::Matched(FilterType::type type) const
+{
+	return message.Matched(type) || process.Matched(type);
+}
+
+LogFilterEngine::LogFilterEngine()
+{
+}
+
+LogFilterEngine::LogFilterEngine(const LogFilter& filter) :
+	m_message(filter.messageFilters),
+	m_process(filter.processFilters)
+{
+}
+
+void LogFilterEngine::Match(const LogFilter& filter, const std::string& processName, const std::string& text, LogFilterMatch& match) const
+{
+	m_process.Match(filter.processFilters, processName, match.process);
+	m_message.Match(filter.messageFilters, text, match.message);
+}
+
+void LogFilterEngine::Match(const LogFilter& filter, FilterCache& processCache, DWORD uid, const std::string& processName, const std::string& text, LogFilterMatch& match) const
+{
+	m_process.Match(filter.processFilters, processCache, uid, processName, match.process);
+	m_message.Match(filter.messageFilters, text, match.message);
+}
+
+FilterVerdict::FilterVerdict() :
+	excluded(false),
+	includeFilterPresent(false),
+	included(false)
+{
+}
+
+bool FilterVerdict::Stateless() const
+{
+	return excluded || (once.empty() && keys.empty());
+}
+
+bool FilterVerdict::Included() const
+{
+	return !excluded && (!includeFilterPresent || included);
+}
+
+void GetFilterVerdict(const std::vector<Filter>& filters, const FilterMatch& match, const std::string& text, FilterVerdict& verdict)
+{
+	verdict.excluded = match.Matched(FilterType::Exclude);
+	verdict.includeFilterPresent = false;
+	verdict.included = false;
+	verdict.once.clear();
+	verdict.keys.clear();
+	if (verdict.excluded)
+		return;
+
+	for (size_t i = 0; i < filters.size(); ++i)
+	{
+		const auto& filter = filters[i];
+		if (!filter.enable)
+			continue;
+
+		if (filter.bgColor == Colors::Auto && match.filters[i])
+			GetMatchKeys(filter, text, verdict.keys);
+
+		if (filter.filterType == FilterType::Include)
+		{
+			verdict.includeFilterPresent = true;
+			verdict.included |= match.filters[i] != 0;
+		}
+
+		if (filter.filterType == FilterType::Once && match.filters[i])
+			verdict.once.push_back(i);
+	}
+}
+
+bool ReduceFilterVerdict(std::vector<Filter>& filters, const FilterVerdict& verdict, MatchColors& matchColors)
+{
+	if (verdict.excluded)
+		return false;
+
+	AddMatchColors(verdict.keys, matchColors);
+
+	bool included = verdict.included;
+	for (auto it = verdict.once.begin(); it != verdict.once.end(); ++it)
+	{
+		included |= !filters[*it].matched;
+		filters[*it].matched = true;
+	}
+
+	return !verdict.includeFilterPresent || included;
+}
+
+bool LogFilterVerdict::Stateless() const
+{
+	return process.Stateless() && (!process.Included() || message.Stateless());
+}
+
+bool LogFilterVerdict::Included() const
+{
+	return process.Included() && message.Included();
+}
+
+void GetLogFilterVerdict(const LogFilter& filter, const LogFilterMatch& match, const std::string& processName, const std::string& text, LogFilterVerdict& verdict)
+{
+	GetFilterVerdict(filter.processFilters, match.process, processName, verdict.process);
+	GetFilterVerdict(filter.messageFilters, match.message, text, verdict.message);
+}
+
+bool ReduceLogFilterVerdict(LogFilter& filter, const LogFilterVerdict& verdict, MatchColors& matchColors)
+{
+	return ReduceFilterVerdict(filter.processFilters, verdict.process, matchColors) &&
+		ReduceFilterVerdict(filter.messageFilters, verdict.message, matchColors);
+}
+
+bool IsIncluded(std::vector<Filter>& filters, const FilterMatch& match, const std::string& text, MatchColors& matchColors)
+{
+	FilterVerdict verdict;
+	GetFilterVerdict(filters, match, text, verdict);
+	return ReduceFilterVerdict(filters, verdict, matchColors);
+}
+
+} // namespace debugviewpp
+} // namespace fusion
@@ -0,0 +1,206 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#include "stdafx.h"
+#include <algorithm>
+#include <emmintrin.h>
+#include "DebugView++Lib/LiteralMatcher.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+namespace {
+
+char Fold(char c)
+{
+	return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+bool IsAscii(char c)
+{
+	return static_cast<unsigned char>(c) < 0x80;
+}
+
+// '.' in an ECMAScript regex does not match line terminators
+bool IsNewline(char c)
+{
+	return c == '\n' || c == '\r';
+}
+
+bool EqualNoCase(const char* text, const char* literal, size_t size)
+{
+	for (size_t i = 0; i < size; ++i)
+	{
+		if (Fold(text[i]) != literal[i])
+			return false;
+	}
+	return true;
+}
+
+// 'A'..'Z' are positive as signed bytes, so the signed compares leave all other bytes unchanged
+__m128i Fold(__m128i x)
+{
+	auto upper = _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(x, _mm_set1_epi8('Z' + 1)));
+	return _mm_or_si128(x, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+} // namespace
+
+size_t FindNoCase(boost::string_ref text, boost::string_ref literal, size_t pos)
+{
+	size_t size = literal.size();
+	if (text.size() < size || pos > text.size() - size)
+		return std::string::npos;
+	if (size == 0)
+		return pos;
+
+	const char* data = text.data();
+	size_t last = text.size() - size;
+	size_t i = pos;
+	if (last - i >= 16)
+	{
+		auto firstChar = _mm_set1_epi8(literal[0]);
+		auto lastChar = _mm_set1_epi8(literal[size - 1]);
+		for (; last - i >= 16; i += 16)
+		{
+			auto head = _mm_cmpeq_epi8(firstChar, Fold(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i))));
+			auto tail = _mm_cmpeq_epi8(lastChar, Fold(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + size - 1))));
+			unsigned mask = _mm_movemask_epi8(_mm_and_si128(head, tail));
+			for (size_t bit = 0; mask != 0; ++bit, mask >>= 1)
+			{
+				if ((mask & 1) != 0 && (size <= 2 || EqualNoCase(data + i + bit + 1, literal.data() + 1, size - 2)))
+					return i + bit;
+			}
+		}
+	}
+
+	for (; i <= last; ++i)
+	{
+		if (EqualNoCase(data + i, literal.data(), size))
+			return i;
+	}
+	return std::string::npos;
+}
+
+LiteralMatcher::LiteralMatcher() :
+	m_literal(false),
+	m_simple(false)
+{
+}
+
+LiteralMatcher::LiteralMatcher(const std::string& text, MatchType::type matchType) :
+	m_literal(false),
+	m_simple(false)
+{
+	if (matchType != MatchType::Simple && matchType != MatchType::Wildcard)
+		return;
+	if (std::find_if(text.begin(), text.end(), [](char c) { return !IsAscii(c) || IsNewline(c); }) != text.end())
+		return;
+
+	// leading and trailing wildcards do not change whether a text matches
+	size_t gap = 0;
+	for (auto it = text.begin(); it != text.end(); ++it)
+	{
+		if (matchType == MatchType::Wildcard && *it == '*')
+		{
+			gap = unbounded;
+		}
+		else if (matchType == MatchType::Wildcard && *it == '?')
+		{
+			if (gap != unbounded)
+				++gap;
+		}
+		else
+		{
+			if (m_segments.empty() || gap != 0)
+				m_segments.push_back(Segment(gap));
+			m_segments.back().text += Fold(*it);
+			gap = 0;
+		}
+	}
+
+	for (size_t i = m_segments.size(); i > 0; --i)
+		m_segments[i - 1].greedy = i == m_segments.size() || (m_segments[i].gap == unbounded && m_segments[i].greedy);
+
+	m_literal = true;
+	m_simple = matchType == MatchType::Simple && !text.empty();
+}
+
+bool LiteralMatcher::IsLiteral() const
+{
+	return m_literal;
+}
+
+bool LiteralMatcher::IsSimple() const
+{
+	return m_simple;
+}
+
+const std::string& LiteralMatcher::Literal() const
+{
+	return m_segments.front().text;
+}
+
+size_t LiteralMatcher::Find(boost::string_ref text, size_t pos) const
+{
+	return FindNoCase(text, m_segments.front().text, pos);
+}
+
+bool LiteralMatcher::Search(boost::string_ref text) const
+{
+	if (m_segments.empty())
+		return true;
+
+	// a greedy first segment only needs to be tried once per line
+	const auto& segment = m_segments.front();
+	for (size_t pos = FindNoCase(text, segment.text); pos != std::string::npos; pos = FindNoCase(text, segment.text, pos + 1))
+	{
+		if (Match(text, 1, pos + segment.text.size()))
+			return true;
+		if (segment.greedy)
+		{
+			while (pos < text.size() && !IsNewline(text[pos]))
+				++pos;
+		}
+	}
+	return false;
+}
+
+// the segments before 'segment' matched up to 'pos'
+bool LiteralMatcher::Match(boost::string_ref text, size_t segment, size_t pos) const
+{
+	if (segment == m_segments.size())
+		return true;
+
+	const auto& current = m_segments[segment];
+	if (current.gap == unbounded)
+	{
+		size_t end = pos;
+		while (end < text.size() && !IsNewline(text[end]))
+			++end;
+		for (size_t i = FindNoCase(text, current.text, pos); i != std::string::npos && i <= end; i = FindNoCase(text, current.text, i + 1))
+		{
+			if (Match(text, segment + 1, i + current.text.size()))
+				return true;
+			if (current.greedy)
+				break;
+		}
+		return false;
+	}
+
+	for (size_t i = pos; i <= pos + current.gap && i + current.text.size() <= text.size(); ++i)
+	{
+		if (i > pos && IsNewline(text[i - 1]))
+			break;
+		if (EqualNoCase(text.data() + i, current.text.data(), current.text.size()) && Match(text, segment + 1, i + current.text.size()))
+			return true;
+	}
+	return false;
+}
+
+} // namespace debugviewpp
+} // namespace fusion
@@ -7,13 +7,95 @@
 
 #include "stdafx.h"
 #include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/make_shared.hpp>
+#include <boost/utility/string_ref.hpp>
+#include "CobaltFusion/make_unique.h"
 #include "CobaltFusion/Str.h"
 #include "Win32/Utilities.h"
+#include "IndexedStorageLib/MappedFileBlockStore.h"
+#include "DebugView++Lib/MappedLogFile.h"
 #include "DebugView++Lib/LogFile.h"
 
 namespace fusion {
 namespace debugviewpp {
 
+namespace {
+
+unsigned char GetLineFlags(boost::string_ref text)
+{
+	unsigned char flags = 0;
+	for (auto it = text.begin(); it != text.end(); ++it)
+	{
+		if (static_cast<unsigned char>(*it) >= 0x80)
+			flags |= LineFlags::NonAscii;
+		else if (*it == '\t')
+			flags |= LineFlags::Tabs;
+	}
+	return flags;
+}
+
+} // namespace
+
+LineColumns::LineColumns() :
+	begin(0),
+	count(0),
+	time(nullptr),
+	systemTime(nullptr),
+	uid(nullptr),
+	length(nullptr),
+	flags(nullptr)
+{
+}
+
+LogFile::MessageColumns::MessageColumns(size_t size) :
+	time(size),
+	systemTime(size),
+	uid(size),
+	length(size),
+	flags(size)
+{
+}
+
+size_t LogFile::MessageColumns::Size() const
+{
+	return time.size();
+}
+
+LogFile::InternalMessage LogFile::MessageColumns::Get(size_t i) const
+{
+	return InternalMessage(time[i], systemTime[i], uid[i], length[i], flags[i]);
+}
+
+void LogFile::MessageColumns::Set(size_t i, const InternalMessage& msg)
+{
+	time[i] = msg.time;
+	systemTime[i] = msg.systemTime;
+	uid[i] = msg.uid;
+	length[i] = msg.length;
+	flags[i] = msg.flags;
+}
+
+void LogFile::MessageColumns::PushBack(const InternalMessage& msg)
+{
+	time.push_back(msg.time);
+	systemTime.push_back(msg.systemTime);
+	uid.push_back(msg.uid);
+	length.push_back(msg.length);
+	flags.push_back(msg.flags);
+}
+
+void LogFile::MessageColumns::GetColumns(size_t i, size_t end, LineColumns& columns) const
+{
+	columns.count = end - i;
+	columns.time = time.data() + i;
+	columns.systemTime = systemTime.data() + i;
+	columns.uid = uid.data() + i;
+	columns.length = length.data() + i;
+	columns.flags = flags.data() + i;
+}
+
 Message::Message(double time, FILETIME systemTime, DWORD pid, const std::string& processName, const std::string& msg, COLORREF color) :
 	time(time), systemTime(systemTime), processId(pid), processName(processName), text(msg), color(color)
 {
@@ -22,48 +104,136 @@ Message::Message(double time, FILETIME systemTime, DWORD pid, const std::string&
 LogFile::LogFile() :
 	m_historySize(0)
 {
+	m_storage = CreateStorage();
 }
 
 bool LogFile::Empty() const
 {
-	return m_messages.empty();
+	return Count() == 0;
 }
 
 void LogFile::Clear()
 {
-	m_messages.clear();
-	m_messages.shrink_to_fit();
-	m_storage.Clear();
-	m_processInfo.Clear();
+	boost::atomic_store(&m_storage, CreateStorage());
 }
 
 void LogFile::Add(const Message& msg)
 {
-	auto props = m_processInfo.GetProcessProperties(msg.processId, WStr(msg.processName).str());
-	m_messages.push_back(InternalMessage(msg.time, msg.systemTime, props.uid));
-	m_storage.Add(msg.text);
+	auto& storage = *m_storage;
+	auto index = storage.endIndex.load(boost::memory_order_relaxed);
+	auto relativeIndex = index - storage.fileCount;
+	if (relativeIndex % indexedstorage::blockSize == 0)
+		storage.tail = storage.messages.PushBack(MessageBlock());
+
+	auto uid = storage.processInfo.GetUid(msg.processId, WStr(msg.processName).str());
+	storage.text.Add(msg.text);
+	storage.tail->messages.Set(relativeIndex % indexedstorage::blockSize, InternalMessage(msg.time, msg.systemTime, uid, static_cast<unsigned>(msg.text.size()), GetLineFlags(msg.text)));
+	// publishing the index last makes the message, text and process properties visible to readers at once
+	storage.endIndex.store(index + 1, boost::memory_order_release);
+
+	TrimHistory();
+}
+
+// Replaces all lines, only the time and process of each line of the file are read here
+void LogFile::Load(const boost::shared_ptr<const MappedLogFile>& file, const std::string& name, FILETIME fileTime)
+{
+	auto storage = CreateStorage();
+	auto fileLines = boost::make_shared<FileLines>();
+	fileLines->file = file;
+	file->ReadLines(name, fileTime, [&](const Line& line)
+	{
+		auto uid = storage->processInfo.GetUid(line.pid, WStr(line.processName).str());
+		auto text = file->GetText(fileLines->messages.Size());
+		fileLines->messages.PushBack(InternalMessage(line.time, line.systemTime, uid, static_cast<unsigned>(text.size()), GetLineFlags(text)));
+	});
+
+	storage->file = fileLines;
+	storage->fileCount = fileLines->messages.Size();
+	storage->endIndex.store(storage->fileCount, boost::memory_order_relaxed);
+	boost::atomic_store(&m_storage, storage);
+	TrimHistory();
 }
 
 size_t LogFile::BeginIndex() const
 {
-	return 0;
+	return GetBeginIndex(*GetStorage());
 }
 
 size_t LogFile::EndIndex() const
 {
-	return m_messages.size();
+	return GetStorage()->endIndex.load(boost::memory_order_acquire);
 }
 
 size_t LogFile::Count() const
 {
-	return m_messages.size();
+	auto storage = GetStorage();
+	auto end = storage->endIndex.load(boost::memory_order_acquire);
+	return end - GetBeginIndex(*storage);
 }
 
 Message LogFile::operator[](size_t i) const
 {
-	auto& msg = m_messages[i];
-	auto props = m_processInfo.GetProcessProperties(msg.uid);
-	return Message(msg.time, msg.systemTime, props.pid, Str(props.name).str(), m_storage[i], props.color);
+	auto storage = GetStorage();
+	auto msg = GetInternalMessage(*storage, i);
+	auto props = storage->processInfo.GetProcessProperties(msg.uid);
+	auto ref = GetStorageText(*storage, i);
+	auto text = ref.str();
+	return Message(msg.time, msg.systemTime, props.pid, Str(props.name).str(), std::string(text.begin(), text.end()), props.color);
+}
+
+indexedstorage::SharedStringRef LogFile::GetText(size_t i) const
+{
+	return GetStorageText(*GetStorage(), i);
+}
+
+double LogFile::GetTime(size_t i) const
+{
+	return GetInternalMessage(*GetStorage(), i).time;
+}
+
+FILETIME LogFile::GetSystemTime(size_t i) const
+{
+	return GetInternalMessage(*GetStorage(), i).systemTime;
+}
+
+DWORD LogFile::GetProcessUid(size_t i) const
+{
+	return GetInternalMessage(*GetStorage(), i).uid;
+}
+
+ProcessProperties LogFile::GetProcessProperties(DWORD uid) const
+{
+	return GetStorage()->processInfo.GetProcessProperties(uid);
+}
+
+LineColumns LogFile::GetColumns(size_t i) const
+{
+	auto storage = GetStorage();
+	auto end = storage->endIndex.load(boost::memory_order_acquire);
+	if (i >= end)
+		throw std::out_of_range("LogFile index out of range");
+
+	LineColumns columns;
+	columns.begin = i;
+	if (i < storage->fileCount)
+	{
+		auto file = boost::atomic_load(&storage->file);
+		if (!file)
+			throw std::out_of_range("LogFile index out of range");
+		file->messages.GetColumns(i, storage->fileCount, columns);
+		columns.block = file;
+		return columns;
+	}
+
+	auto relativeIndex = i - storage->fileCount;
+	auto block = storage->messages.Get(relativeIndex / indexedstorage::blockSize);
+	if (!block)
+		throw std::out_of_range("LogFile index out of range");
+
+	auto offset = relativeIndex % indexedstorage::blockSize;
+	block->messages.GetColumns(offset, std::min(indexedstorage::blockSize, offset + end - i), columns);
+	columns.block = block;
+	return columns;
 }
 
 size_t LogFile::GetHistorySize() const
@@ -76,5 +246,95 @@ void LogFile::SetHistorySize(size_t size)
 	m_historySize = size;
 }
 
+std::wstring LogFile::GetStorageDirectory() const
+{
+	return m_storageDirectory;
+}
+
+// An empty directory keeps all text in memory. The new setting applies to the storage
+// that is created at the next Clear(), or right away when there are no lines yet.
+void LogFile::SetStorageDirectory(const std::wstring& directory)
+{
+	m_storageDirectory = directory;
+	if (m_storage->endIndex.load(boost::memory_order_relaxed) == 0)
+		boost::atomic_store(&m_storage, CreateStorage());
+}
+
+boost::shared_ptr<LogFile::Storage> LogFile::CreateStorage() const
+{
+	if (m_storageDirectory.empty())
+		return boost::make_shared<Storage>(make_unique<indexedstorage::MemoryBlockStore>());
+	return boost::make_shared<Storage>(make_unique<indexedstorage::MappedFileBlockStore>(m_storageDirectory));
+}
+
+boost::shared_ptr<const LogFile::Storage> LogFile::GetStorage() const
+{
+	return boost::atomic_load(&m_storage);
+}
+
+size_t LogFile::GetBeginIndex(const Storage& storage)
+{
+	if (boost::atomic_load(&storage.file))
+		return 0;
+	return storage.fileCount + storage.messages.BeginIndex() * indexedstorage::blockSize;
+}
+
+LogFile::InternalMessage LogFile::GetInternalMessage(const Storage& storage, size_t i)
+{
+	if (i >= storage.endIndex.load(boost::memory_order_acquire))
+		throw std::out_of_range("LogFile index out of range");
+
+	if (i < storage.fileCount)
+	{
+		auto file = boost::atomic_load(&storage.file);
+		if (!file)
+			throw std::out_of_range("LogFile index out of range");
+		return file->messages.Get(i);
+	}
+
+	i -= storage.fileCount;
+	auto block = storage.messages.Get(i / indexedstorage::blockSize);
+	if (!block)
+		throw std::out_of_range("LogFile index out of range");
+
+	return block->messages.Get(i % indexedstorage::blockSize);
+}
+
+indexedstorage::SharedStringRef LogFile::GetStorageText(const Storage& storage, size_t i)
+{
+	if (i >= storage.endIndex.load(boost::memory_order_acquire))
+		throw std::out_of_range("LogFile index out of range");
+
+	if (i < storage.fileCount)
+	{
+		auto file = boost::atomic_load(&storage.file);
+		if (!file)
+			throw std::out_of_range("LogFile index out of range");
+		return indexedstorage::SharedStringRef(file->file->GetText(i), file);
+	}
+
+	return storage.text.GetStringRef(i - storage.fileCount);
+}
+
+// Drop whole blocks from the front as long as at least m_historySize lines remain.
+// The tail block is never dropped, so the text of dropped blocks is always sealed.
+// The lines of a loaded file go first, all at once, so the remaining lines stay contiguous.
+void LogFile::TrimHistory()
+{
+	if (m_historySize == 0)
+		return;
+
+	auto& storage = *m_storage;
+	auto end = storage.endIndex.load(boost::memory_order_relaxed) - storage.fileCount;
+	if (storage.file && end >= m_historySize)
+		boost::atomic_store(&storage.file, boost::shared_ptr<const FileLines>());
+
+	while ((storage.messages.BeginIndex() + 1) * indexedstorage::blockSize + m_historySize <= end)
+	{
+		storage.messages.PopFront();
+		storage.text.PopFront();
+	}
+}
+
 } // namespace debugviewpp 
 } // namespace fusion
@@ -0,0 +1,193 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#include "stdafx.h"
+#include <algorithm>
+#include <stdexcept>
+#include "DebugView++Lib/LogFile.h"
+#include "DebugView++Lib/TrigramIndex.h"
+#include "DebugView++Lib/LogSearch.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+// the worker hands its matches to the GUI thread at most this often
+const boost::chrono::milliseconds postInterval(50);
+
+LogSearch::LogSearch(const LogFile& logFile, const TrigramIndex& textIndex, const std::string& text, MatchType::type matchType, std::function<void ()> update) :
+	m_logFile(logFile),
+	m_textIndex(textIndex),
+	m_filter(text, matchType, FilterType::Include),
+	m_update(update),
+	m_beginIndex(logFile.BeginIndex()),
+	m_endIndex(m_beginIndex),
+	m_dropped(0),
+	m_pending(true),
+	m_stop(false)
+{
+	m_thread = boost::thread(&LogSearch::Run, this);
+}
+
+LogSearch::~LogSearch()
+{
+	// the worker is stopped first, the GuiExecutor then drops the matches it did not deliver yet
+	{
+		boost::lock_guard<boost::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_cond.notify_one();
+	m_thread.join();
+}
+
+const std::string& LogSearch::GetText() const
+{
+	return m_filter.text;
+}
+
+MatchType::type LogSearch::GetMatchType() const
+{
+	return m_filter.matchType;
+}
+
+void LogSearch::Notify()
+{
+	if (m_pending.exchange(true))
+		return;
+
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	m_cond.notify_one();
+}
+
+size_t LogSearch::EndIndex() const
+{
+	return m_endIndex;
+}
+
+bool LogSearch::Done() const
+{
+	return m_endIndex >= m_logFile.EndIndex();
+}
+
+int LogSearch::Progress() const
+{
+	size_t end = m_logFile.EndIndex();
+	if (m_endIndex >= end)
+		return 100;
+	return static_cast<int>((m_endIndex - m_beginIndex) * 100 / (end - m_beginIndex));
+}
+
+size_t LogSearch::Count() const
+{
+	return m_matches.size();
+}
+
+size_t LogSearch::Dropped() const
+{
+	return m_dropped;
+}
+
+int LogSearch::GetMatch(size_t i) const
+{
+	return m_matches[i];
+}
+
+int LogSearch::Next(int line) const
+{
+	auto it = std::upper_bound(m_matches.begin(), m_matches.end(), line);
+	return it == m_matches.end() ? -1 : *it;
+}
+
+int LogSearch::Previous(int line) const
+{
+	auto it = std::lower_bound(m_matches.begin(), m_matches.end(), line);
+	return it == m_matches.begin() ? -1 : *--it;
+}
+
+void LogSearch::Run()
+{
+	bool simple = m_filter.matchType == MatchType::Simple;
+	size_t line = m_beginIndex;
+	std::vector<int> matches;
+	auto postTime = boost::chrono::steady_clock::now() + postInterval;
+	for (;;)
+	{
+		{
+			boost::unique_lock<boost::mutex> lock(m_mutex);
+			while (!m_stop && !m_pending.exchange(false))
+				m_cond.wait(lock);
+			if (m_stop)
+				return;
+		}
+
+		// one query per batch of lines, blocks that are indexed later are candidates until the next batch
+		auto query = simple ? m_textIndex.Query(m_filter.text) : TrigramQuery();
+		line = std::max(line, m_logFile.BeginIndex());
+		size_t end = m_logFile.EndIndex();
+		while (line < end)
+		{
+			if (m_stop)
+				return;
+
+			size_t blockEnd = std::min(end, (line / indexedstorage::blockSize + 1) * indexedstorage::blockSize);
+			if (query.MayContain(line))
+			{
+				for (; line < blockEnd; ++line)
+				{
+					try
+					{
+						if (IsMatch(m_logFile.GetText(line)))
+							matches.push_back(static_cast<int>(line));
+					}
+					catch (std::out_of_range&)
+					{
+						// the line was dropped from the history
+					}
+				}
+			}
+			line = blockEnd;
+
+			auto now = boost::chrono::steady_clock::now();
+			if (now >= postTime)
+			{
+				Post(matches, line);
+				matches.clear();
+				postTime = now + postInterval;
+			}
+		}
+		Post(matches, line);
+		matches.clear();
+	}
+}
+
+bool LogSearch::IsMatch(boost::string_ref text) const
+{
+	const auto& pattern = *m_filter.pattern;
+	if (pattern.literal.IsLiteral())
+		return pattern.literal.Search(text);
+	return std::regex_search(text.begin(), text.end(), pattern.re);
+}
+
+void LogSearch::Post(const std::vector<int>& matches, size_t end)
+{
+	m_executor.CallAsync([this, matches, end]() { Merge(matches, end); });
+}
+
+void LogSearch::Merge(const std::vector<int>& matches, size_t end)
+{
+	int beginIndex = static_cast<int>(m_logFile.BeginIndex());
+	while (!m_matches.empty() && m_matches.front() < beginIndex)
+	{
+		m_matches.pop_front();
+		++m_dropped;
+	}
+	m_matches.insert(m_matches.end(), matches.begin(), matches.end());
+	m_endIndex = end;
+	m_update();
+}
+
+} // namespace debugviewpp
+} // namespace fusion
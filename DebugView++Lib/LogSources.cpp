@@ -7,7 +7,7 @@
 
 #include "stdafx.h"
 #include <cassert>
-#include <boost/algorithm/string.hpp>
+#include <algorithm>
 #include "CobaltFusion/stringbuilder.h"
 #include "Win32/Win32Lib.h"
 #include "Win32/Utilities.h"
@@ -24,13 +24,16 @@
 #include "DebugView++Lib/ProcessInfo.h"
 #include "DebugView++Lib/Conversions.h"
 #include "DebugView++Lib/LineBuffer.h"
-#include "DebugView++Lib/VectorLineBuffer.h"
+#include "DebugView++Lib/CircularLineBuffer.h"
+#include "DebugView++Lib/PassiveLogSource.h"
 #include "DebugView++Lib/Loopback.h"
 #include "CobaltFusion/make_unique.h"
 
 // class Logsources has a vector<LogSource> and start a thread for LogSources::Listen()
 // - Listen() exectues every LogSource::GetHandle() in m_sources and calls Notify() for any signaled handle.
 // - LogSource::Notify reads input en writes to linebuffer (passed at construction)
+// - Normalize() takes the lines from the linebuffer on its own thread, splits them at newlines, trims them and resolves their pid,
+//   GetLines() hands these lines to the GUI thread
 // 
 
 namespace fusion {
@@ -38,18 +41,33 @@ namespace debugviewpp {
 
 const boost::chrono::seconds handleCacheTimeout(5);
 
+// bytes queued between the sources and the normalize thread, when full the newest lines are dropped,
+// blocking would stall the DBWIN reader and with it every process that calls OutputDebugString
+const size_t lineBufferSize = 1024 * 1024;
+
+// lines queued by each polled source
+const size_t sourceLimit = 64 * 1024;
+
+// normalized lines waiting for GetLines(), when full the normalize thread waits for the GUI
+const size_t normalizedLinesLimit = 64 * 1024;
+
 LogSources::LogSources(bool startListening) : 
 	m_end(false),
 	m_autoNewLine(true),
+	m_sourceLimit(sourceLimit),
+	m_sourcePolicy(OverflowPolicy::DropNewest),
 	m_updateEvent(CreateEvent(nullptr, false, false, nullptr)),
-	m_linebuffer(64*1024),
+	m_linebuffer(lineBufferSize, OverflowPolicy::DropNewest),
 	m_loopback(CreateLoopback(m_timer, m_linebuffer)),
-	m_updatePending(false)
+	m_updatePending(false),
+	m_normalizePending(false),
+	m_normalizeEnd(false),
+	m_normalizeLimit(normalizedLinesLimit)
 {
-	
+	m_normalizeThread = boost::thread(&LogSources::Normalize, this);
 	if (startListening)
 		m_listenThread = boost::thread(&LogSources::Listen, this);
-	m_processMonitor.ConnectProcessEnded([this](DWORD pid, HANDLE handle) { OnProcessEnded(pid, handle); });
+	m_processEndedConnection = m_processMonitor.ConnectProcessEnded([this](DWORD pid, HANDLE handle) { OnProcessEnded(pid, handle); });
 }
 	
 LogSources::~LogSources()
@@ -74,6 +92,8 @@ void LogSources::AddMessage(const std::string& message)
 void LogSources::UpdateSettings(const std::unique_ptr<LogSource>& pSource)
 {
 	pSource->SetAutoNewLine(GetAutoNewLine());
+	if (auto pPassiveSource = dynamic_cast<PassiveLogSource*>(pSource.get()))
+		pPassiveSource->SetLimit(m_sourceLimit, m_sourcePolicy);
 }
 
 void LogSources::Add(std::unique_ptr<LogSource> pSource)
@@ -81,7 +101,10 @@ void LogSources::Add(std::unique_ptr<LogSource> pSource)
 	assert(m_guiExecutor.IsExecutorThread());
 	boost::mutex::scoped_lock lock(m_mutex);
 	UpdateSettings(pSource);
-	m_sources.emplace_back(std::move(pSource));
+	{
+		boost::mutex::scoped_lock inUseLock(m_sourcesInUseMutex);
+		m_sources.emplace_back(std::move(pSource));
+	}
 	Win32::SetEvent(m_updateEvent);
 }
 
@@ -97,9 +120,16 @@ void LogSources::InternalRemove(LogSource* pLogSource)
 	AddMessage(stringbuilder() << "Source '" << pLogSource->GetDescription() << "' was removed.");
 	boost::mutex::scoped_lock lock(m_mutex);
 	pLogSource->Abort();
+	if (auto pPassiveSource = dynamic_cast<const PassiveLogSource*>(pLogSource))
+		m_removedSourceCounters += pPassiveSource->GetCounters();
 	std::vector<LogSource*> v;
 	v.push_back(pLogSource);
-	EraseElements(m_sources, v);
+	{
+		boost::mutex::scoped_lock inUseLock(m_sourcesInUseMutex);
+		EraseElements(m_sources, v);
+		m_removedSources.push_back(pLogSource);
+	}
+	NotifyNormalize();
 }
 
 std::vector<LogSource*> LogSources::GetSources() const
@@ -126,6 +156,80 @@ bool LogSources::GetAutoNewLine() const
 	return m_autoNewLine;
 }
 
+size_t LogSources::GetSourceLimit() const
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	return m_sourceLimit;
+}
+
+OverflowPolicy::type LogSources::GetSourcePolicy() const
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	return m_sourcePolicy;
+}
+
+void LogSources::SetSourceLimit(size_t lines, OverflowPolicy::type policy)
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	m_sourceLimit = lines;
+	m_sourcePolicy = policy;
+	for (auto it = m_sources.begin(); it != m_sources.end(); ++it)
+	{
+		// the loopback keeps its own limit, see Loopback::Loopback()
+		auto pPassiveSource = dynamic_cast<PassiveLogSource*>(it->get());
+		if (pPassiveSource && pPassiveSource != m_loopback)
+			pPassiveSource->SetLimit(lines, policy);
+	}
+}
+
+StageCounters LogSources::GetSourceCounters() const
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	StageCounters counters = m_removedSourceCounters;
+	for (auto it = m_sources.begin(); it != m_sources.end(); ++it)
+	{
+		if (auto pPassiveSource = dynamic_cast<const PassiveLogSource*>(it->get()))
+			counters += pPassiveSource->GetCounters();
+	}
+	return counters;
+}
+
+OverflowPolicy::type LogSources::GetLineBufferPolicy() const
+{
+	return m_linebuffer.GetPolicy();
+}
+
+void LogSources::SetLineBufferPolicy(OverflowPolicy::type policy)
+{
+	m_linebuffer.SetPolicy(policy);
+}
+
+StageCounters LogSources::GetLineBufferCounters() const
+{
+	return m_linebuffer.GetCounters();
+}
+
+size_t LogSources::GetNormalizeLimit() const
+{
+	boost::lock_guard<boost::mutex> lock(m_normalizeMutex);
+	return m_normalizeLimit;
+}
+
+void LogSources::SetNormalizeLimit(size_t lines)
+{
+	{
+		boost::lock_guard<boost::mutex> lock(m_normalizeMutex);
+		m_normalizeLimit = lines;
+	}
+	m_normalizeCond.notify_one();
+}
+
+StageCounters LogSources::GetNormalizeCounters() const
+{
+	boost::lock_guard<boost::mutex> lock(m_normalizeMutex);
+	return m_normalizeCounters;
+}
+
 void LogSources::Abort()
 {
 	m_end = true;
@@ -134,8 +238,17 @@ void LogSources::Abort()
 	{
 		(*it)->Abort();
 	}
+	m_linebuffer.Abort();
 	Win32::SetEvent(m_updateEvent);
 	m_listenThread.join();
+
+	m_processEndedConnection.disconnect();
+	{
+		boost::lock_guard<boost::mutex> lock(m_normalizeMutex);
+		m_normalizeEnd = true;
+	}
+	m_normalizeCond.notify_one();
+	m_normalizeThread.join();
 }
 
 void LogSources::Reset()
@@ -226,8 +339,7 @@ void LogSources::ListenUntilUpdateEvent()
 				assert((index < static_cast<int>(sources.size())) && "res.index out of range");
 				auto logsource = sources[index];
 				logsource->Notify();
-				if (!m_updatePending)
-					OnUpdate();
+				NotifyNormalize();
 			}
 		}
 	}
@@ -256,18 +368,41 @@ void LogSources::UpdateSources()
 
 void LogSources::OnProcessEnded(DWORD pid, HANDLE handle)
 {
-	m_guiExecutor.CallAsync([this, pid, handle]
 	{
-		auto flushedLines = m_newlineFilter.FlushLinesFromTerminatedProcess(pid, handle);
-		for (auto it = flushedLines.begin(); it != flushedLines.end(); ++it)
-			m_loopback->AddMessage(it->pid, it->processName, it->message);
+		boost::lock_guard<boost::mutex> lock(m_normalizeMutex);
+		m_endedProcesses.push_back(std::make_pair(pid, handle));
+	}
+	NotifyNormalize();
+}
 
-		if (!flushedLines.empty())
-			m_loopback->Signal();
+void LogSources::FlushEndedProcesses(const std::vector<std::pair<DWORD, HANDLE>>& processes)
+{
+	for (auto process = processes.begin(); process != processes.end(); ++process)
+	{
+		DWORD pid = process->first;
+		AddFlushedLines(m_newlineFilter.FlushLinesFromTerminatedProcess(pid, process->second));
 		auto it = m_pidMap.find(pid);
 		if (it != m_pidMap.end())
 			m_pidMap.erase(it);
-	});
+	}
+}
+
+// called with m_sourcesInUseMutex held, before the lines of a new source that can have the address of a removed source
+void LogSources::FlushRemovedSources()
+{
+	for (auto source = m_removedSources.begin(); source != m_removedSources.end(); ++source)
+		AddFlushedLines(m_newlineFilter.FlushLinesFromSource(*source));
+	m_removedSources.clear();
+}
+
+// the loopback source queues the lines flushed from m_newlineFilter again, it fills in their timestamps
+void LogSources::AddFlushedLines(const Lines& lines)
+{
+	for (auto it = lines.begin(); it != lines.end(); ++it)
+		m_loopback->AddMessage(it->pid, it->processName, it->message);
+
+	if (!lines.empty())
+		m_loopback->Signal();
 }
 
 bool LogSources::LogSourceExists(const LogSource* pLogSource) const
@@ -280,14 +415,84 @@ bool LogSources::LogSourceExists(const LogSource* pLogSource) const
 	return false;
 }
 
+void LogSources::NotifyNormalize()
+{
+	// only the first NotifyNormalize() after the normalize thread took the lines has to wake it up
+	if (m_normalizePending.exchange(true))
+		return;
+
+	boost::lock_guard<boost::mutex> lock(m_normalizeMutex);
+	m_normalizeCond.notify_one();
+}
+
 Lines LogSources::GetLines()
 {
-	auto inputLines = m_linebuffer.GetLines();
 	Lines lines;
+	{
+		boost::lock_guard<boost::mutex> lock(m_normalizeMutex);
+		lines.swap(m_lines);
+	}
+	// wakes a normalize thread that waits for room and takes the lines of a LogSources that is not listening
+	m_normalizeCond.notify_one();
+	NotifyNormalize();
+	return lines;
+}
+
+void LogSources::Normalize()
+{
+	for (;;)
+	{
+		std::vector<std::pair<DWORD, HANDLE>> endedProcesses;
+		{
+			// the timeout takes the lines of sources that are not notified by the listen thread
+			boost::unique_lock<boost::mutex> lock(m_normalizeMutex);
+			if (m_lines.size() >= m_normalizeLimit)
+				++m_normalizeCounters.blocked;
+			while (!m_normalizeEnd &&
+				(m_lines.size() >= m_normalizeLimit ||
+				(!m_normalizePending.exchange(false) && m_endedProcesses.empty() && m_linebuffer.Empty())))
+			{
+				m_normalizeCond.wait_for(lock, graceTime);
+			}
+			if (m_normalizeEnd)
+				return;
+			endedProcesses.swap(m_endedProcesses);
+		}
+
+		auto inputLines = m_linebuffer.GetLines();
+		Lines lines;
+		NormalizeLines(inputLines, lines);
+		FlushEndedProcesses(endedProcesses);
+		if (lines.empty())
+			continue;
+
+		{
+			boost::lock_guard<boost::mutex> lock(m_normalizeMutex);
+			m_normalizeCounters.added += lines.size();
+			if (m_lines.empty())
+				m_lines.swap(lines);
+			else
+				m_lines.insert(m_lines.end(), lines.begin(), lines.end());
+			m_normalizeCounters.peak = std::max(m_normalizeCounters.peak, m_lines.size());
+		}
+		if (!m_updatePending)
+			OnUpdate();
+	}
+}
+
+void LogSources::NormalizeLines(Lines& inputLines, Lines& lines)
+{
+	// the GUI thread removes and destroys sources, this keeps the sources of the lines alive
+	boost::mutex::scoped_lock inUseLock(m_sourcesInUseMutex);
+	FlushRemovedSources();
+	lines.reserve(inputLines.size());
+	const LogSource* pKnownSource = nullptr;
 	for (auto it = inputLines.begin(); it != inputLines.end(); ++it)
 	{
+		// consecutive lines mostly come from the same source
 		auto& inputLine = *it;
-		if (!LogSourceExists(inputLine.pLogSource)) continue;
+		if (!inputLine.pLogSource || (inputLine.pLogSource != pKnownSource && !LogSourceExists(inputLine.pLogSource))) continue;
+		pKnownSource = inputLine.pLogSource;
 
 		// let the logsource decide how to create processname
 		if (inputLine.pLogSource)
@@ -313,14 +518,8 @@ Lines LogSources::GetLines()
 
 		// since a line can contain multiple newlines, processing 1 line can output
 		// multiple lines, in this case the timestamp for each line is the same.
-		auto processedLines = m_newlineFilter.Process(inputLine);
-		for (auto it = processedLines.begin(); it != processedLines.end(); ++it)
-		{
-			boost::trim_right_if(it->message, boost::is_any_of("\r\n"));
-			lines.push_back(*it);
-		}
+		m_newlineFilter.Process(inputLine, lines);
 	}
-	return lines;
 }
 
 DBWinReader* LogSources::AddDBWinReader(bool global)
@@ -11,9 +11,13 @@
 namespace fusion {
 namespace debugviewpp {
 
+// the GUI thread adds messages to the loopback, it must never wait for the LogSources thread
+const size_t loopbackCapacity = 4096;
+
 Loopback::Loopback(Timer& timer, ILineBuffer& linebuffer) : PassiveLogSource(timer, SourceType::System, linebuffer, 0)
 {
 	SetDescription(L"Loopback");
+	SetLimit(loopbackCapacity, OverflowPolicy::DropNewest);
 }
 
 Loopback::~Loopback()
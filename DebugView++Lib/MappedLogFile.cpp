@@ -0,0 +1,264 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#include "stdafx.h"
+#include <limits>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <deque>
+#include <intrin.h>
+#include <emmintrin.h>
+#include <boost/thread.hpp>
+#include "CobaltFusion/make_unique.h"
+#include "CobaltFusion/Executor.h"
+#include "DebugView++Lib/Conversions.h"
+#include "DebugView++Lib/DBLogReader.h"
+#include "DebugView++Lib/MappedLogFile.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+void IndexLines(const char* data, size_t size, std::vector<size_t>& lines)
+{
+	if (size == 0)
+		return;
+
+	lines.push_back(0);
+	const __m128i newline = _mm_set1_epi8('\n');
+	size_t offset = 0;
+	for (; offset + 16 <= size; offset += 16)
+	{
+		auto mask = static_cast<unsigned long>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset)), newline)));
+		while (mask != 0)
+		{
+			unsigned long bit;
+			_BitScanForward(&bit, mask);
+			lines.push_back(offset + bit + 1);
+			mask &= mask - 1;
+		}
+	}
+
+	for (; offset < size; ++offset)
+	{
+		if (data[offset] == '\n')
+			lines.push_back(offset + 1);
+	}
+
+	// a newline at the end of the file does not start another line
+	if (lines.back() == size)
+		lines.pop_back();
+}
+
+// skip 'count' tab separated columns, returns npos if the line has fewer columns
+size_t SkipColumns(boost::string_ref line, int count)
+{
+	size_t pos = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		auto tab = line.substr(pos).find('\t');
+		if (tab == boost::string_ref::npos)
+			return tab;
+		pos += tab + 1;
+	}
+	return pos;
+}
+
+// returns the offset of the message text in a line, the columns before it hold the time and process
+size_t GetTextOffset(FileType::type fileType, boost::string_ref line)
+{
+	switch (fileType)
+	{
+	case FileType::DebugViewPP1:
+	case FileType::DebugViewPP2:
+		{
+			auto pos = SkipColumns(line, 4);
+			return pos == boost::string_ref::npos ? 0 : pos;
+		}
+	case FileType::Sysinternals:
+		{
+			// messages from processes are preceeded by [pid], kernel messages do not have a prefix
+			auto pos = SkipColumns(line, 2);
+			if (pos == boost::string_ref::npos)
+				return 0;
+			if (pos < line.size() && line[pos] == '[')
+			{
+				auto end = line.substr(pos).find("] ");
+				if (end != boost::string_ref::npos)
+					return pos + end + 2;
+			}
+			return pos;
+		}
+	default:
+		return 0;
+	}
+}
+
+MappedLogFile::MappedLogFile(const std::wstring& filename, FileType::type fileType) :
+	m_fileType(fileType),
+	m_data(nullptr),
+	m_size(0)
+{
+	HANDLE hFile = ::CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+		Win32::ThrowLastError(filename);
+	m_file.reset(hFile);
+
+	LARGE_INTEGER size;
+	if (!::GetFileSizeEx(m_file.get(), &size))
+		Win32::ThrowLastError(filename);
+	if (static_cast<unsigned long long>(size.QuadPart) > std::numeric_limits<size_t>::max())
+		throw std::runtime_error("file too large to map into memory");
+
+	m_size = static_cast<size_t>(size.QuadPart);
+	if (m_size == 0)
+		return;
+
+	m_mapping = Win32::CreateFileMapping(m_file.get(), nullptr, PAGE_READONLY, 0, 0, nullptr);
+	m_view = make_unique<Win32::MappedViewOfFile>(m_mapping.get(), FILE_MAP_READ, 0, 0, m_size);
+	m_data = static_cast<const char*>(m_view->Ptr());
+	IndexLines(m_data, m_size, m_lines);
+
+	// the identification header of a DebugView++ file is not a message
+	if ((fileType == FileType::DebugViewPP1 || fileType == FileType::DebugViewPP2) && !m_lines.empty())
+		m_lines.erase(m_lines.begin());
+}
+
+FileType::type MappedLogFile::GetFileType() const
+{
+	return m_fileType;
+}
+
+size_t MappedLogFile::Count() const
+{
+	return m_lines.size();
+}
+
+boost::string_ref MappedLogFile::GetLine(size_t i) const
+{
+	auto begin = m_lines[i];
+	auto end = i + 1 < m_lines.size() ? m_lines[i + 1] : m_size;
+	while (end > begin && (m_data[end - 1] == '\n' || m_data[end - 1] == '\r'))
+		--end;
+	return boost::string_ref(m_data + begin, end - begin);
+}
+
+boost::string_ref MappedLogFile::GetText(size_t i) const
+{
+	auto line = GetLine(i);
+	return line.substr(GetTextOffset(m_fileType, line));
+}
+
+// ParsedChunk holds the lines of a chunk of the file as parsed by a worker thread.
+// US region times are only converted when the chunk is merged, because the day rollover
+// of each time depends on the times of all lines before it.
+struct ParsedChunk
+{
+	std::vector<Line> lines;
+	std::vector<std::pair<size_t, USTime>> usTimes;
+};
+
+ParsedChunk ParseChunk(const MappedLogFile& file, size_t begin, size_t end, const std::string& name, FILETIME fileTime, TimeFormat::type timeFormat)
+{
+	ParsedChunk chunk;
+	chunk.lines.resize(end - begin);
+	for (size_t i = begin; i < end; ++i)
+	{
+		auto& line = chunk.lines[i - begin];
+		auto header = file.GetLine(i);
+		header = header.substr(0, GetTextOffset(file.GetFileType(), header));
+		switch (file.GetFileType())
+		{
+		case FileType::Sysinternals:
+			{
+				USTime time;
+				if (ParseSysInternalsLogFileMessage(header, line, time, timeFormat))
+					chunk.usTimes.push_back(std::make_pair(i - begin, time));
+			}
+			break;
+		case FileType::DebugViewPP1:
+		case FileType::DebugViewPP2:
+			if (header.empty())
+				header = file.GetLine(i);
+			ReadLogFileMessage(header, line);
+			break;
+		default:
+			line.systemTime = fileTime;
+			line.processName = name;
+			break;
+		}
+		line.message.clear();
+	}
+	return chunk;
+}
+
+// Chunks of lines are parsed on a pool of worker threads and merged in order on the calling thread,
+// at most two chunks per worker are in flight, so the memory use does not depend on the file size.
+void MappedLogFile::ReadLines(const std::string& name, FILETIME fileTime, const std::function<void (const Line& line)>& add) const
+{
+	auto count = m_lines.size();
+	auto chunks = (count + chunkSize - 1) / chunkSize;
+	auto threads = std::min<size_t>(std::max(boost::thread::hardware_concurrency(), 1U), chunks);
+
+	std::vector<std::unique_ptr<ActiveExecutor>> workers;
+	for (size_t i = 0; i < threads; ++i)
+		workers.push_back(make_unique<ActiveExecutor>());
+
+	// the time format is detected on the first line, so the workers do not each detect it again
+	auto timeFormat = TimeFormat::Unknown;
+	if (m_fileType == FileType::Sysinternals && count > 0)
+	{
+		Line line;
+		USTime time;
+		ParseSysInternalsLogFileMessage(GetLine(0), line, time, timeFormat);
+	}
+
+	std::deque<boost::unique_future<ParsedChunk>> pending;
+	size_t queued = 0;
+	USTimeConverter converter;
+	FILETIME firstFileTime = FILETIME();
+	size_t index = 0;
+	while (index < count)
+	{
+		for (; queued < chunks && pending.size() < 2 * workers.size(); ++queued)
+		{
+			auto begin = queued * chunkSize;
+			auto end = std::min(begin + chunkSize, count);
+			pending.push_back(workers[queued % workers.size()]->CallAsync([this, begin, end, name, fileTime, timeFormat]()
+			{
+				return ParseChunk(*this, begin, end, name, fileTime, timeFormat);
+			}));
+		}
+
+		auto chunk = pending.front().get();
+		pending.pop_front();
+
+		auto usTime = chunk.usTimes.begin();
+		for (size_t i = 0; i < chunk.lines.size(); ++i, ++index)
+		{
+			auto& line = chunk.lines[i];
+			if (usTime != chunk.usTimes.end() && usTime->first == i)
+			{
+				line.systemTime = converter.Convert(usTime->second);
+				++usTime;
+			}
+
+			// Sysinternals files only store the system time, the relative time is taken from the first line
+			if (m_fileType == FileType::Sysinternals && line.time == 0.0)
+			{
+				if (index == 0)
+					firstFileTime = line.systemTime;
+				else
+					line.time = GetDifference(firstFileTime, line.systemTime);
+			}
+			add(line);
+		}
+	}
+}
+
+} // namespace debugviewpp 
+} // namespace fusion
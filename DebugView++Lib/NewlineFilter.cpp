@@ -6,6 +6,8 @@
 // Repository at: https://github.com/djeedjay/DebugViewPP/
 
 #include "stdafx.h"
+#include <cstring>
+#include <algorithm>
 #include "CobaltFusion/stringbuilder.h"
 #include "DebugView++Lib/LogSource.h"
 #include "DebugView++Lib/ProcessInfo.h"
@@ -14,55 +16,129 @@
 namespace fusion {
 namespace debugviewpp {
 
-Lines NewlineFilter::Process(const Line& line)
+namespace {
+
+// appends [begin, end) to 'text' without the '\r' characters
+void AppendText(std::string& text, const char* begin, const char* end)
 {
-	Lines lines;
-	auto& message = m_lineBuffers[line.pid];
-	message.reserve(4000);
+	while (begin != end)
+	{
+		auto cr = static_cast<const char*>(std::memchr(begin, '\r', end - begin));
+		text.append(begin, cr ? cr : end);
+		begin = cr ? cr + 1 : end;
+	}
+}
+
+void RemoveCarriageReturns(std::string& text)
+{
+	if (std::memchr(text.data(), '\r', text.size()))
+		text.erase(std::remove(text.begin(), text.end(), '\r'), text.end());
+}
+
+// adds a line with the time, pid and source of 'line' and returns its message, the process name is set by Process()
+std::string& AddLine(const Line& line, Lines& lines)
+{
+	lines.push_back(Line());
+	auto& output = lines.back();
+	output.time = line.time;
+	output.systemTime = line.systemTime;
+	output.handle = line.handle;
+	output.pid = line.pid;
+	output.pLogSource = line.pLogSource;
+	return output.message;
+}
+
+} // namespace
+
+void NewlineFilter::Process(Line& line, Lines& lines)
+{
+	size_t first = lines.size();
+	Key key(line.pLogSource, line.pid);
+	auto partial = m_lineBuffers.find(key);
+	const char* data = line.message.data();
+	size_t size = line.message.size();
+	auto newline = static_cast<const char*>(std::memchr(data, '\n', size));
+	bool autoNewLine = line.pLogSource->GetAutoNewLine();
 
-	Line outputLine = line;
-	for (auto it = line.message.begin(); it != line.message.end(); ++it)
+	if (partial == m_lineBuffers.end() && (newline ? newline == data + size - 1 : size > 0 && autoNewLine))
 	{
-		if (*it == '\r')
-			continue;
+		// the common case, a message of exactly one line takes the message string of 'line'
+		auto& text = AddLine(line, lines);
+		text.swap(line.message);
+		if (newline)
+			text.resize(size - 1);
+		RemoveCarriageReturns(text);
+		if (!newline && text.empty())
+			lines.pop_back();
+	}
+	else
+	{
+		size_t begin = 0;
+		for (; newline; newline = static_cast<const char*>(std::memchr(data + begin, '\n', size - begin)))
+		{
+			auto& text = AddLine(line, lines);
+			if (partial != m_lineBuffers.end())
+			{
+				text.swap(partial->second);
+				m_lineBuffers.erase(partial);
+				partial = m_lineBuffers.end();
+			}
+			AppendText(text, data + begin, newline);
+			begin = newline - data + 1;
+		}
 
-		if (*it == '\n')
+		if (partial == m_lineBuffers.end() && autoNewLine)
 		{
-			outputLine.message = message;
-			message.clear();
-			lines.push_back(outputLine);
+			if (begin < size)
+			{
+				auto& text = AddLine(line, lines);
+				AppendText(text, data + begin, data + size);
+				if (text.empty())
+					lines.pop_back();
+			}
 		}
-		else
+		else if (begin < size || partial != m_lineBuffers.end())
 		{
-			message.push_back(*it);
+			// the text after the last newline waits for the rest of its line
+			auto& buffer = partial != m_lineBuffers.end() ? partial->second : m_lineBuffers[key];
+			AppendText(buffer, data + begin, data + size);
+			if (!buffer.empty() && (autoNewLine || buffer.size() > maxLineSize))
+				AddLine(line, lines).swap(buffer);
+			if (buffer.empty())
+				m_lineBuffers.erase(key);
 		}
 	}
 
-	if (message.empty())
-	{
-		m_lineBuffers.erase(line.pid);
-	}
-	else if (outputLine.pLogSource->GetAutoNewLine() || message.size() > 8192)	// 8k line limit prevents stack overflow in handling code 
+	// the last line takes the process name of 'line', the others copy it
+	if (lines.size() > first)
 	{
-		outputLine.message = message;
-		message.clear();
-		lines.push_back(outputLine);
+		for (auto it = lines.begin() + first; it + 1 != lines.end(); ++it)
+			it->processName = line.processName;
+		lines.back().processName.swap(line.processName);
 	}
-	return lines;
 }
 
-Lines NewlineFilter::FlushLinesFromTerminatedProcess(DWORD pid, HANDLE handle)
+void NewlineFilter::Flush(const std::function<bool (const Key& key)>& predicate, Lines& lines)
 {
-	Lines lines;
-	if (m_lineBuffers.find(pid) != m_lineBuffers.end())
+	for (auto it = m_lineBuffers.begin(); it != m_lineBuffers.end(); )
 	{
-		if (!m_lineBuffers[pid].empty())
+		if (!predicate(it->first))
 		{
-			// timestamp not filled, this will be done by the loopback source
-			lines.push_back(Line(0, FILETIME(), pid, "<flush>", m_lineBuffers[pid], nullptr));
+			++it;
+			continue;
 		}
-		m_lineBuffers.erase(pid);
+
+		// timestamp not filled, this will be done by the loopback source
+		if (!it->second.empty())
+			lines.push_back(Line(0, FILETIME(), it->first.second, "<flush>", it->second, nullptr));
+		it = m_lineBuffers.erase(it);
 	}
+}
+
+Lines NewlineFilter::FlushLinesFromTerminatedProcess(DWORD pid, HANDLE handle)
+{
+	Lines lines;
+	Flush([pid](const Key& key) { return key.second == pid; }, lines);
 	auto processName = Str(ProcessInfo::GetProcessName(handle)).str();
 	auto info = ProcessInfo::GetProcessInfo(handle);
 	std::string infoStr = stringbuilder() << "<process started at " << info << " has now terminated>";
@@ -70,5 +146,12 @@ Lines NewlineFilter::FlushLinesFromTerminatedProcess(DWORD pid, HANDLE handle)
 	return lines;
 }
 
+Lines NewlineFilter::FlushLinesFromSource(const LogSource* pSource)
+{
+	Lines lines;
+	Flush([pSource](const Key& key) { return key.first == pSource; }, lines);
+	return lines;
+}
+
 } // namespace debugviewpp 
 } // namespace fusion
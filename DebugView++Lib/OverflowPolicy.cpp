@@ -0,0 +1,51 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#include "stdafx.h"
+#include <algorithm>
+#include "CobaltFusion/stringbuilder.h"
+#include "DebugView++Lib/OverflowPolicy.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+std::string OverflowPolicyToString(OverflowPolicy::type policy)
+{
+	switch (policy)
+	{
+	case OverflowPolicy::Block: return "block";
+	case OverflowPolicy::DropOldest: return "drop oldest";
+	case OverflowPolicy::DropNewest: return "drop newest";
+	default: break;
+	}
+	return "unknown";
+}
+
+StageCounters::StageCounters() :
+	added(0),
+	dropped(0),
+	blocked(0),
+	peak(0)
+{
+}
+
+StageCounters& operator+=(StageCounters& counters, const StageCounters& stage)
+{
+	counters.added += stage.added;
+	counters.dropped += stage.dropped;
+	counters.blocked += stage.blocked;
+	counters.peak = std::max(counters.peak, stage.peak);
+	return counters;
+}
+
+std::string GetDroppedLinesMessage(size_t count)
+{
+	return stringbuilder() << count << (count == 1 ? " line" : " lines") << " dropped\n";
+}
+
+} // namespace debugviewpp
+} // namespace fusion
@@ -0,0 +1,154 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#include "stdafx.h"
+#include <algorithm>
+#include <stdexcept>
+#include "CobaltFusion/make_unique.h"
+#include "DebugView++Lib/LogFile.h"
+#include "DebugView++Lib/ParallelFilter.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+FilteredLine::FilteredLine(int line, bool stateful) :
+	line(line),
+	stateful(stateful)
+{
+}
+
+ParallelFilter::ParallelFilter(const LogFile& logFile, const LogFilter& filter, size_t begin, size_t end) :
+	m_logFile(logFile),
+	m_filter(filter),
+	m_engine(m_filter),
+	m_begin(begin),
+	m_end(end),
+	m_firstBlock(begin / indexedstorage::blockSize),
+	m_blocks(begin < end ? (end - 1) / indexedstorage::blockSize + 1 - m_firstBlock : 0),
+	m_cancel(false),
+	m_nextBlock(0),
+	m_filteredBlocks(0),
+	m_mergedBlocks(0),
+	m_results(m_blocks)
+{
+	size_t threads = std::min<size_t>(std::max(boost::thread::hardware_concurrency(), 1u), m_blocks);
+	for (size_t i = 0; i < threads; ++i)
+		m_threads.create_thread([this]() { Run(); });
+}
+
+ParallelFilter::~ParallelFilter()
+{
+	m_cancel = true;
+	{
+		boost::lock_guard<boost::mutex> lock(m_mutex);
+		m_cond.notify_all();
+	}
+	m_threads.join_all();
+}
+
+size_t ParallelFilter::Poll(const std::function<void (const FilteredBlock& block)>& merge)
+{
+	size_t count = 0;
+	for (;;)
+	{
+		std::unique_ptr<FilteredBlock> block;
+		{
+			boost::lock_guard<boost::mutex> lock(m_mutex);
+			if (m_mergedBlocks == m_blocks || !m_results[m_mergedBlocks])
+				break;
+			block = std::move(m_results[m_mergedBlocks]);
+			++m_mergedBlocks;
+			m_cond.notify_all();
+		}
+		merge(*block);
+		++count;
+	}
+	return count;
+}
+
+void ParallelFilter::Wait()
+{
+	boost::unique_lock<boost::mutex> lock(m_mutex);
+	while (m_filteredBlocks < m_blocks)
+		m_cond.wait(lock);
+}
+
+bool ParallelFilter::Done() const
+{
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	return m_mergedBlocks == m_blocks;
+}
+
+int ParallelFilter::Progress() const
+{
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	return m_blocks == 0 ? 100 : static_cast<int>(m_mergedBlocks * 100 / m_blocks);
+}
+
+void ParallelFilter::Run()
+{
+	FilterCache processCache;
+	LogFilterMatch match;
+	LogFilterVerdict verdict;
+	for (;;)
+	{
+		size_t block;
+		{
+			// the workers stay at most maxPendingBlocks ahead of the merge to bound the memory of unmerged results
+			boost::unique_lock<boost::mutex> lock(m_mutex);
+			while (!m_cancel && m_nextBlock < m_blocks && m_nextBlock >= m_mergedBlocks + maxPendingBlocks)
+				m_cond.wait(lock);
+			if (m_cancel || m_nextBlock == m_blocks)
+				return;
+			block = m_nextBlock++;
+		}
+
+		auto result = make_unique<FilteredBlock>();
+		FilterBlock(block, processCache, match, verdict, *result);
+
+		boost::lock_guard<boost::mutex> lock(m_mutex);
+		m_results[block] = std::move(result);
+		++m_filteredBlocks;
+		m_cond.notify_all();
+	}
+}
+
+void ParallelFilter::FilterBlock(size_t block, FilterCache& processCache, LogFilterMatch& match, LogFilterVerdict& verdict, FilteredBlock& result) const
+{
+	size_t begin = std::max(m_begin, (m_firstBlock + block) * indexedstorage::blockSize);
+	size_t end = std::min(m_end, (m_firstBlock + block + 1) * indexedstorage::blockSize);
+	LineColumns columns;
+	for (size_t line = begin; line < end && !m_cancel; ++line)
+	{
+		try
+		{
+			if (line < columns.begin || line >= columns.begin + columns.count)
+				columns = m_logFile.GetColumns(line);
+			auto msg = m_logFile[line];
+			m_engine.Match(m_filter, processCache, columns.uid[line - columns.begin], msg.processName, msg.text, match);
+			GetLogFilterVerdict(m_filter, match, msg.processName, msg.text, verdict);
+		}
+		catch (std::out_of_range&)
+		{
+			// the line was dropped from the history, the merge skips it as well
+			continue;
+		}
+
+		if (!verdict.Stateless())
+		{
+			result.lines.push_back(FilteredLine(static_cast<int>(line), true));
+			result.verdicts.push_back(verdict);
+		}
+		else if (verdict.Included())
+		{
+			result.lines.push_back(FilteredLine(static_cast<int>(line), false));
+		}
+	}
+}
+
+} // namespace debugviewpp
+} // namespace fusion
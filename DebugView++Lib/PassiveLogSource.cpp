@@ -6,6 +6,7 @@
 // Repository at: https://github.com/djeedjay/DebugViewPP/
 
 #include "stdafx.h"
+#include <algorithm>
 #include "Win32/Win32Lib.h"
 #include "DebugView++Lib/PassiveLogSource.h"
 #include "DebugView++Lib/LineBuffer.h"
@@ -34,8 +35,14 @@ PollLine::PollLine(double time, FILETIME systemTime, DWORD pid, const std::strin
 {
 }
 
+// lines queued between two Notify() calls, when full the newest lines are dropped, OverflowPolicy::Block is opt-in
+const size_t defaultCapacity = 64 * 1024;
+
 PassiveLogSource::PassiveLogSource(Timer& timer, SourceType::type sourceType, ILineBuffer& linebuffer, long pollFrequency) :
 	LogSource(timer, sourceType, linebuffer),
+	m_capacity(defaultCapacity),
+	m_policy(OverflowPolicy::DropNewest),
+	m_droppedLines(0),
 	m_microsecondInterval(pollFrequency > 0 ? 1000000 / pollFrequency : 0),
 	m_handle(Win32::CreateEvent(nullptr, false, false, nullptr))
 {
@@ -55,6 +62,10 @@ long PassiveLogSource::GetMicrosecondInterval() const
 void PassiveLogSource::Abort()
 {
 	LogSource::Abort();
+	{
+		boost::mutex::scoped_lock lock(m_mutex);
+		m_cond.notify_all();
+	}
 	m_thread.join();
 }
 
@@ -79,9 +90,13 @@ HANDLE PassiveLogSource::GetHandle() const
 void PassiveLogSource::Notify()
 {
 	// this swap is essential for efficiency.
+	size_t dropped;
 	{
 		boost::mutex::scoped_lock lock(m_mutex);
 		m_lines.swap(m_backBuffer);
+		dropped = m_droppedLines;
+		m_droppedLines = 0;
+		m_cond.notify_all();
 	}
 
 	for (auto it = m_backBuffer.cbegin(); it != m_backBuffer.cend(); ++it)
@@ -92,6 +107,10 @@ void PassiveLogSource::Notify()
 			Add(it->pid, it->processName, it->message);
 	}
 	m_backBuffer.clear();
+
+	// the dropped lines were newer than all lines taken by this Notify()
+	if (dropped > 0)
+		AddInternal(GetDroppedLinesMessage(dropped));
 }
 
 void PassiveLogSource::Poll()
@@ -100,26 +119,69 @@ void PassiveLogSource::Poll()
 
 void PassiveLogSource::AddMessage(DWORD pid, const std::string& processName, const std::string& message)
 {
-	boost::mutex::scoped_lock lock(m_mutex);
-	m_lines.push_back(PollLine(pid, processName, message, this));
+	Queue(PollLine(pid, processName, message, this));
 }
 
 void PassiveLogSource::AddMessage(const std::string& message)
 {
-	boost::mutex::scoped_lock lock(m_mutex);
 	std::string msg = message + "\n";
-	m_lines.push_back(PollLine(0, "[internal]", msg, this));
+	Queue(PollLine(0, "[internal]", msg, this));
 }
 
 void PassiveLogSource::AddMessage(double time, FILETIME systemTime, DWORD pid, const std::string& processName, const std::string& message)
 {
-	m_lines.push_back(PollLine(time, systemTime, pid, processName, message, this));
+	Queue(PollLine(time, systemTime, pid, processName, message, this));
+}
+
+void PassiveLogSource::Queue(const PollLine& line)
+{
+	// LogSource::AtEnd() is set by Abort(), an override like ProcessReader::AtEnd() reports the end of its input
+	boost::mutex::scoped_lock lock(m_mutex);
+	if (m_lines.size() >= m_capacity && m_policy == OverflowPolicy::Block && !LogSource::AtEnd())
+	{
+		++m_counters.blocked;
+		// Notify() makes room, it is called when the handle is signaled
+		SetEvent(m_handle.get());
+		while (m_lines.size() >= m_capacity && m_policy == OverflowPolicy::Block && !LogSource::AtEnd())
+			m_cond.wait(lock);
+	}
+	while (m_lines.size() >= m_capacity && m_policy == OverflowPolicy::DropOldest && !m_lines.empty())
+	{
+		m_lines.pop_front();
+		++m_counters.dropped;
+	}
+
+	if (m_lines.size() >= m_capacity || m_droppedLines > 0)
+	{
+		++m_counters.dropped;
+		if (m_policy == OverflowPolicy::DropNewest)
+			++m_droppedLines;
+		return;
+	}
+
+	m_lines.push_back(line);
+	++m_counters.added;
+	m_counters.peak = std::max(m_counters.peak, m_lines.size());
+}
+
+void PassiveLogSource::SetLimit(size_t capacity, OverflowPolicy::type policy)
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	m_capacity = capacity;
+	m_policy = policy;
+	m_cond.notify_all();
+}
+
+StageCounters PassiveLogSource::GetCounters() const
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	return m_counters;
 }
 
 void PassiveLogSource::Signal()
 {
 	boost::mutex::scoped_lock lock(m_mutex);
-	if (!m_lines.empty())
+	if (!m_lines.empty() || m_droppedLines > 0)
 		SetEvent(m_handle.get());
 }
 
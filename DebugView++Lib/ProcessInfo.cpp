@@ -34,14 +34,14 @@ ProcessProperties::ProcessProperties(const InternalProcessProperties& iprops) :
 {
 }
 
-ProcessInfo::ProcessInfo() : m_unqiueId(0)
+ProcessInfo::ProcessInfo()
 {
 }
 
 void ProcessInfo::Clear()
 {
-	m_unqiueId = 0;
-	m_processProperties.clear();
+	m_processProperties.Clear();
+	m_uids.clear();
 }
 
 size_t ProcessInfo::GetPrivateBytes()
@@ -88,17 +88,18 @@ std::wstring ProcessInfo::GetProcessNameByPid(DWORD processId)
 
 DWORD ProcessInfo::GetUid(DWORD processId, const std::wstring& processName)
 {
-	for (auto i = m_processProperties.begin(); i != m_processProperties.end(); ++i)
+	// a processId has more than one uid only when it was reused by a process with another name
+	auto& uids = m_uids[processId];
+	for (auto it = uids.begin(); it != uids.end(); ++it)
 	{
-		if (i->second.pid == processId && i->second.name == processName)
-			return i->first;
+		if (m_processProperties[*it].name == processName)
+			return *it;
 	}
 
-	DWORD index = m_unqiueId;
-	++m_unqiueId;
-
-	m_processProperties[index] = InternalProcessProperties(processId, processName, GetRandomProcessColor());
-	return index;
+	auto uid = static_cast<DWORD>(m_processProperties.Size());
+	m_processProperties.PushBack(InternalProcessProperties(processId, processName, GetRandomProcessColor()));
+	uids.push_back(uid);
+	return uid;
 }
 
 ProcessProperties ProcessInfo::GetProcessProperties(DWORD processId, const std::wstring& processName)
@@ -111,12 +112,11 @@ ProcessProperties ProcessInfo::GetProcessProperties(DWORD processId, const std::
 
 ProcessProperties ProcessInfo::GetProcessProperties(DWORD uid) const
 {
-	auto it = m_processProperties.find(uid);
-	assert(it != m_processProperties.end());
-	if (it == m_processProperties.end())
+	assert(uid < m_processProperties.Size());
+	if (uid >= m_processProperties.Size())
 		return ProcessProperties(InternalProcessProperties());
 
-	return ProcessProperties(it->second);
+	return ProcessProperties(m_processProperties[uid]);
 }
 
 } // namespace debugviewpp 
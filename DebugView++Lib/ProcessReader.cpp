@@ -30,6 +30,9 @@ ProcessReader::~ProcessReader()
 
 void ProcessReader::Abort()
 {
+	// Abort() runs on the GUI thread, the source is ended first so that with OverflowPolicy::Block this line
+	// does not wait for room: the listen thread that would make room can be waiting for the GUI thread
+	LogSource::Abort();
 	AddMessage(m_process.GetProcessId(), Str(m_process.GetName()).str(), "<process terminated>");
 	PassiveLogSource::Abort();
 }
@@ -0,0 +1,223 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#include "stdafx.h"
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+#include "DebugView++Lib/TimeParser.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+namespace {
+
+bool IsSpace(char c)
+{
+	return c == ' ' || c == '\t';
+}
+
+bool IsDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+// Scanner reads the fields of a string_ref from left to right, like operator>> does
+// leading spaces are skipped before a number, but not before a separator.
+class Scanner
+{
+public:
+	explicit Scanner(boost::string_ref text) :
+		m_it(text.begin()),
+		m_end(text.end())
+	{
+	}
+
+	void SkipSpaces()
+	{
+		while (m_it != m_end && IsSpace(*m_it))
+			++m_it;
+	}
+
+	bool Read(char c)
+	{
+		if (m_it == m_end || *m_it != c)
+			return false;
+		++m_it;
+		return true;
+	}
+
+	bool ReadNumber(WORD& value)
+	{
+		SkipSpaces();
+		auto begin = m_it;
+		unsigned n = 0;
+		for (; m_it != m_end && IsDigit(*m_it); ++m_it)
+		{
+			n = 10 * n + (*m_it - '0');
+			if (n > 0xFFFF)
+				return false;
+		}
+		value = static_cast<WORD>(n);
+		return m_it != begin;
+	}
+
+private:
+	boost::string_ref::const_iterator m_it;
+	boost::string_ref::const_iterator m_end;
+};
+
+bool IsValid(const USTime& time)
+{
+	return time.hour < 24 && time.minute < 60 && time.second < 60 && time.milliseconds < 1000;
+}
+
+double Pow10(int n)
+{
+	static const double table[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	return static_cast<size_t>(n) < sizeof(table)/sizeof(table[0]) ? table[n] : std::pow(10.0, n);
+}
+
+} // namespace
+
+TimeFormat::type DetectTimeFormat(boost::string_ref text)
+{
+	static const TimeFormat::type formats[] = { TimeFormat::USRegionMs, TimeFormat::USRegion, TimeFormat::LocalMs, TimeFormat::Local };
+
+	USTime time;
+	for (size_t i = 0; i < sizeof(formats)/sizeof(formats[0]); ++i)
+	{
+		if (ParseTimeOfDay(text, formats[i], time))
+			return formats[i];
+	}
+
+	double relative;
+	if (ParseRelativeTime(text, relative))
+		return TimeFormat::Relative;
+	return TimeFormat::Unknown;
+}
+
+bool ParseTimeOfDay(boost::string_ref text, TimeFormat::type format, USTime& time)
+{
+	Scanner scanner(text);
+	if (!(scanner.ReadNumber(time.hour) && scanner.Read(':') && scanner.ReadNumber(time.minute) && scanner.Read(':') && scanner.ReadNumber(time.second)))
+		return false;
+
+	time.milliseconds = 0;
+	if (format == TimeFormat::USRegionMs || format == TimeFormat::LocalMs)
+	{
+		if (!(scanner.Read('.') && scanner.ReadNumber(time.milliseconds)))
+			return false;
+	}
+	else if (scanner.Read('.'))
+	{
+		return false;
+	}
+
+	scanner.SkipSpaces();
+	bool am = scanner.Read('A');
+	bool pm = !am && scanner.Read('P');
+	bool usRegion = (am || pm) && scanner.Read('M');
+	if (usRegion != (format == TimeFormat::USRegionMs || format == TimeFormat::USRegion))
+		return false;
+
+	if (usRegion)
+	{
+		if (time.hour == 0 || time.hour > 12)
+			return false;
+		if (time.hour == 12)
+			time.hour = 0;
+		if (pm)
+			time.hour += 12;
+	}
+	return IsValid(time);
+}
+
+bool ParseRelativeTime(boost::string_ref text, double& time)
+{
+	// the integer mantissa and the power of 10 are applied in one step, so a value written with
+	// "%.06f" that fits in 53 bits reads back exactly as operator>> would have read it
+	static const uint64_t maxMantissa = 100000000000000000ULL;
+
+	auto it = text.begin();
+	auto end = text.end();
+	while (it != end && IsSpace(*it))
+		++it;
+
+	bool negative = false;
+	if (it != end && (*it == '-' || *it == '+'))
+		negative = *it++ == '-';
+
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	int digits = 0;
+	for (; it != end && IsDigit(*it); ++it, ++digits)
+	{
+		if (mantissa < maxMantissa)
+			mantissa = 10 * mantissa + (*it - '0');
+		else
+			++exponent;
+	}
+	if (it != end && *it == '.')
+	{
+		for (++it; it != end && IsDigit(*it); ++it, ++digits)
+		{
+			if (mantissa < maxMantissa)
+			{
+				mantissa = 10 * mantissa + (*it - '0');
+				--exponent;
+			}
+		}
+	}
+	if (digits == 0)
+		return false;
+
+	if (it != end && (*it == 'e' || *it == 'E'))
+	{
+		++it;
+		bool negativeExponent = false;
+		if (it != end && (*it == '-' || *it == '+'))
+			negativeExponent = *it++ == '-';
+		if (it == end || !IsDigit(*it))
+			return false;
+		int n = 0;
+		for (; it != end && IsDigit(*it); ++it)
+			n = std::min(10 * n + (*it - '0'), 10000);
+		exponent += negativeExponent ? -n : n;
+	}
+	if (it != end)
+		return false;
+
+	double value = static_cast<double>(mantissa);
+	value = exponent < 0 ? value / Pow10(-exponent) : value * Pow10(exponent);
+	time = negative ? -value : value;
+	return true;
+}
+
+bool ParseDateTime(boost::string_ref text, SYSTEMTIME& st)
+{
+	SYSTEMTIME result = { 0 };
+	Scanner scanner(text);
+	if (!(scanner.ReadNumber(result.wYear) && scanner.Read('/') && scanner.ReadNumber(result.wMonth) && scanner.Read('/') && scanner.ReadNumber(result.wDay) &&
+		scanner.Read(' ') && scanner.ReadNumber(result.wHour) && scanner.Read(':') && scanner.ReadNumber(result.wMinute) && scanner.Read(':') && scanner.ReadNumber(result.wSecond) &&
+		scanner.Read('.') && scanner.ReadNumber(result.wMilliseconds)))
+		return false;
+
+	if (result.wMonth < 1 || result.wMonth > 12 || result.wDay < 1 || result.wDay > 31 ||
+		result.wHour > 23 || result.wMinute > 59 || result.wSecond > 59 || result.wMilliseconds > 999)
+		return false;
+
+	st = result;
+	return true;
+}
+
+} // namespace debugviewpp
+} // namespace fusion
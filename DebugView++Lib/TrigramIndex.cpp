@@ -0,0 +1,180 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#include "stdafx.h"
+#include <algorithm>
+#include <stdexcept>
+#include "DebugView++Lib/LogFile.h"
+#include "DebugView++Lib/TrigramIndex.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+namespace {
+
+bool IsAscii(char c)
+{
+	return static_cast<unsigned char>(c) < 0x80;
+}
+
+unsigned Fold(char c)
+{
+	return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : static_cast<unsigned char>(c);
+}
+
+// other than ASCII characters are not indexed, their case folding depends on the locale
+template <typename F>
+void ForEachTrigram(boost::string_ref text, int bits, F f)
+{
+	for (size_t i = 2; i < text.size(); ++i)
+	{
+		if (IsAscii(text[i - 2]) && IsAscii(text[i - 1]) && IsAscii(text[i]))
+			f(((Fold(text[i - 2]) << 16 | Fold(text[i - 1]) << 8 | Fold(text[i])) * 2654435761u) >> (32 - bits));
+	}
+}
+
+} // namespace
+
+TrigramQuery::TrigramQuery() :
+	m_all(true),
+	m_firstBlock(0)
+{
+}
+
+bool TrigramQuery::MayContain(size_t i) const
+{
+	size_t block = i / indexedstorage::blockSize;
+	return m_all || block < m_firstBlock || block - m_firstBlock >= m_candidates.size() || m_candidates[block - m_firstBlock];
+}
+
+TrigramIndex::TrigramIndex(const LogFile& logFile) :
+	m_logFile(logFile),
+	m_pending(true),
+	m_stop(false),
+	m_generation(0),
+	m_firstBlock(0)
+{
+	m_thread = boost::thread(&TrigramIndex::Run, this);
+}
+
+TrigramIndex::~TrigramIndex()
+{
+	{
+		boost::lock_guard<boost::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_cond.notify_one();
+	m_thread.join();
+}
+
+void TrigramIndex::Notify()
+{
+	if (m_pending.exchange(true))
+		return;
+
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	m_cond.notify_one();
+}
+
+void TrigramIndex::Clear()
+{
+	// a block that is being indexed from the old lines is discarded by the generation check
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	++m_generation;
+	m_firstBlock = 0;
+	m_signatures.clear();
+}
+
+TrigramQuery TrigramIndex::Query(const std::string& text) const
+{
+	boost::dynamic_bitset<> trigrams(size_t(1) << signatureBits);
+	ForEachTrigram(text, signatureBits, [&trigrams](unsigned hash) { trigrams.set(hash); });
+
+	TrigramQuery query;
+	if (trigrams.none())
+		return query;
+
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	query.m_all = false;
+	query.m_firstBlock = m_firstBlock;
+	query.m_candidates.resize(m_signatures.size());
+	for (size_t i = 0; i < m_signatures.size(); ++i)
+		query.m_candidates[i] = trigrams.is_subset_of(m_signatures[i]);
+	return query;
+}
+
+size_t TrigramIndex::Size() const
+{
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	return m_signatures.size();
+}
+
+void TrigramIndex::Run()
+{
+	for (;;)
+	{
+		{
+			boost::unique_lock<boost::mutex> lock(m_mutex);
+			while (!m_stop && !m_pending.exchange(false))
+				m_cond.wait(lock);
+			if (m_stop)
+				return;
+		}
+		IndexBlocks();
+	}
+}
+
+void TrigramIndex::IndexBlocks()
+{
+	boost::dynamic_bitset<> signature(size_t(1) << signatureBits);
+	for (;;)
+	{
+		size_t generation;
+		size_t block;
+		{
+			boost::lock_guard<boost::mutex> lock(m_mutex);
+			if (m_stop)
+				return;
+
+			// drop the signatures of the blocks that left the history
+			size_t firstBlock = m_logFile.BeginIndex() / indexedstorage::blockSize;
+			while (m_firstBlock < firstBlock && !m_signatures.empty())
+			{
+				m_signatures.pop_front();
+				++m_firstBlock;
+			}
+			m_firstBlock = std::max(m_firstBlock, firstBlock);
+			generation = m_generation;
+			block = m_firstBlock + m_signatures.size();
+		}
+
+		size_t begin = block * indexedstorage::blockSize;
+		size_t end = begin + indexedstorage::blockSize;
+		if (end > m_logFile.EndIndex())
+			return;
+
+		signature.reset();
+		for (size_t line = begin; line < end; ++line)
+		{
+			try
+			{
+				ForEachTrigram(m_logFile.GetText(line), signatureBits, [&signature](unsigned hash) { signature.set(hash); });
+			}
+			catch (std::out_of_range&)
+			{
+				// the line was dropped from the history or cleared, the generation check discards the latter
+			}
+		}
+
+		boost::lock_guard<boost::mutex> lock(m_mutex);
+		if (generation == m_generation && block == m_firstBlock + m_signatures.size())
+			m_signatures.push_back(signature);
+	}
+}
+
+} // namespace debugviewpp
+} // namespace fusion
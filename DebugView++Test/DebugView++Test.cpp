@@ -12,20 +12,40 @@
 #include <boost/filesystem.hpp>
 #include <random>
 #include <fstream>
+#include <sstream>
+#include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/algorithm/string.hpp>
 
 #include "Win32/Utilities.h"
 #include "Win32/Win32Lib.h"
 #include "CobaltFusion/stringbuilder.h"
+#include "CobaltFusion/make_unique.h"
 #include "IndexedStorageLib/IndexedStorage.h"
+#include "IndexedStorageLib/MappedFileBlockStore.h"
 #include "DebugView++Lib/ProcessInfo.h"
 #include "DebugView++Lib/DBWinBuffer.h"
 #include "DebugView++Lib/LogSources.h"
 #include "DebugView++Lib/LogSource.h"
 #include "DebugView++Lib/TestSource.h"
 #include "DebugView++Lib/VectorLineBuffer.h"
+#include "DebugView++Lib/CircularLineBuffer.h"
+#include "DebugView++Lib/Loopback.h"
+#include "DebugView++Lib/NewlineFilter.h"
 #include "DebugView++Lib/LogFile.h"
+#include "DebugView++Lib/MappedLogFile.h"
 #include "DebugView++Lib/FileIO.h"
+#include "DebugView++Lib/FileWriter.h"
 #include "DebugView++Lib/Conversions.h"
+#include "DebugView++Lib/Colors.h"
+#include "DebugView++Lib/TimeParser.h"
+#include "DebugView++Lib/FilterEngine.h"
+#include "DebugView++Lib/LiteralMatcher.h"
+#include "DebugView++Lib/ParallelFilter.h"
+#include "DebugView++Lib/TrigramIndex.h"
+#include "DebugView++Lib/LogSearch.h"
 #include "CobaltFusion/scope_guard.h"
 
 namespace fusion {
@@ -130,6 +150,738 @@ bool AreEqual(const LogFile& a, const LogFile& b)
 	return true;
 }
 
+BOOST_AUTO_TEST_CASE(LogFileHistorySize)
+{
+	LogFile logFile;
+	logFile.SetHistorySize(1000);
+	auto t = Win32::GetSystemTimeAsFileTime();
+	for (int i = 0; i < 10000; ++i)
+		logFile.Add(Message(i, t, 0, "processname", GetTestString(i)));
+
+	BOOST_REQUIRE_EQUAL(logFile.EndIndex(), 10000);
+	BOOST_REQUIRE_GT(logFile.BeginIndex(), 0);
+	BOOST_REQUIRE_GE(logFile.Count(), 1000);
+	BOOST_REQUIRE_LT(logFile.Count(), 1000 + indexedstorage::blockSize);
+	for (size_t i = logFile.BeginIndex(); i < logFile.EndIndex(); ++i)
+		BOOST_REQUIRE_EQUAL(logFile[i].text, GetTestString(i));
+	BOOST_REQUIRE_THROW(logFile[logFile.BeginIndex() - 1], std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE(LogFileColumns)
+{
+	LogFile logFile;
+	auto t = Win32::GetSystemTimeAsFileTime();
+	for (int i = 0; i < 1000; ++i)
+		logFile.Add(Message(i, t, i % 3, i % 2 == 0 ? "even" : "odd", i % 10 == 0 ? "tab\tseparated" : GetTestString(i)));
+
+	auto columns = logFile.GetColumns(410);
+	BOOST_REQUIRE_EQUAL(columns.begin, 410);
+	BOOST_REQUIRE_EQUAL(columns.count, 2 * indexedstorage::blockSize - 410);
+	for (size_t i = 0; i < columns.count; ++i)
+	{
+		size_t line = columns.begin + i;
+		auto msg = logFile[line];
+		BOOST_REQUIRE_EQUAL(columns.time[i], msg.time);
+		BOOST_REQUIRE_EQUAL(columns.length[i], msg.text.size());
+		BOOST_REQUIRE_EQUAL((columns.flags[i] & LineFlags::Tabs) != 0, line % 10 == 0);
+		auto props = logFile.GetProcessProperties(columns.uid[i]);
+		BOOST_REQUIRE_EQUAL(props.pid, msg.processId);
+		BOOST_REQUIRE(props.name == WStr(msg.processName).str());
+		BOOST_REQUIRE_EQUAL(logFile.GetTime(line), msg.time);
+		BOOST_REQUIRE_EQUAL(logFile.GetProcessUid(line), columns.uid[i]);
+	}
+
+	// the tail block ends at EndIndex()
+	BOOST_REQUIRE_EQUAL(logFile.GetColumns(999).count, 1);
+	BOOST_REQUIRE_THROW(logFile.GetColumns(1000), std::out_of_range);
+
+	// the columns stay valid when their block is dropped
+	logFile.SetHistorySize(100);
+	logFile.Add(Message(1000, t, 0, "even", "trim"));
+	BOOST_REQUIRE_GT(logFile.BeginIndex(), 410);
+	BOOST_REQUIRE_THROW(logFile.GetColumns(410), std::out_of_range);
+	BOOST_REQUIRE_EQUAL(columns.time[0], 410);
+}
+
+BOOST_AUTO_TEST_CASE(IndexLinesTest)
+{
+	std::string text = "line 1\r\nline 2\n\nthe fourth line is longer than sixteen characters\nlast";
+	std::vector<size_t> lines;
+	IndexLines(text.data(), text.size(), lines);
+	BOOST_REQUIRE_EQUAL(lines.size(), 5);
+	BOOST_REQUIRE_EQUAL(lines[1], 8);
+	BOOST_REQUIRE_EQUAL(lines[2], 15);
+	BOOST_REQUIRE_EQUAL(lines[3], 16);
+	BOOST_REQUIRE_EQUAL(text.substr(lines[4]), "last");
+
+	lines.clear();
+	IndexLines(text.data(), text.size() - 4, lines);
+	BOOST_REQUIRE_EQUAL(lines.size(), 4);
+}
+
+BOOST_AUTO_TEST_CASE(LogFileLoadMappedFile)
+{
+	auto filename = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+	auto guard = make_guard([&]() { boost::filesystem::remove(filename); });
+	{
+		std::ofstream ofs;
+		OpenLogFile(ofs, filename.wstring());
+		auto t = Win32::GetSystemTimeAsFileTime();
+		for (int i = 0; i < 1000; ++i)
+			WriteLogFileMessage(ofs, i, t, i % 10, "processname", GetTestString(i));
+	}
+
+	auto file = boost::make_shared<MappedLogFile>(filename.wstring(), IdentifyFile(filename.wstring()));
+	BOOST_REQUIRE_EQUAL(file->GetFileType(), FileType::DebugViewPP1);
+
+	LogFile logFile;
+	logFile.Load(file, "test", Win32::GetSystemTimeAsFileTime());
+	BOOST_REQUIRE_EQUAL(logFile.Count(), 1000);
+	for (size_t i = 0; i < logFile.Count(); ++i)
+	{
+		auto msg = logFile[i];
+		BOOST_REQUIRE_EQUAL(msg.text, GetTestString(i));
+		BOOST_REQUIRE_EQUAL(msg.processId, i % 10);
+		BOOST_REQUIRE_EQUAL(msg.processName, "processname");
+	}
+
+	logFile.Add(Message(0, Win32::GetSystemTimeAsFileTime(), 0, "processname", "added"));
+	BOOST_REQUIRE_EQUAL(logFile[1000].text, "added");
+}
+
+std::string GetUSTimeText(int seconds)
+{
+	int h = seconds / 3600 % 24;
+	char buf[32];
+	sprintf_s(buf, "%02d:%02d:%02d.%03d %s", h % 12 == 0 ? 12 : h % 12, seconds / 60 % 60, seconds % 60, seconds % 1000, h < 12 ? "AM" : "PM");
+	return buf;
+}
+
+BOOST_AUTO_TEST_CASE(MappedLogFileParallelParsing)
+{
+	auto filename = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("%%%%-%%%%-%%%%.log");
+	auto guard = make_guard([&]() { boost::filesystem::remove(filename); });
+
+	// the time of day wraps around several times, also within and across chunk boundaries
+	std::vector<std::string> lines;
+	for (int i = 0; i < 100000; ++i)
+		lines.push_back(stringbuilder() << i << "\t" << GetUSTimeText(i * 7) << "\t[" << 100 + i % 3 << "] message " << i);
+	{
+		std::ofstream ofs(filename.string(), std::ios::binary);
+		for (auto it = lines.begin(); it != lines.end(); ++it)
+			ofs << *it << "\r\n";
+	}
+
+	MappedLogFile file(filename.wstring(), IdentifyFile(filename.wstring()));
+	BOOST_REQUIRE_EQUAL(file.GetFileType(), FileType::Sysinternals);
+	BOOST_REQUIRE_EQUAL(file.Count(), lines.size());
+
+	std::vector<Line> parsed;
+	file.ReadLines("test", FILETIME(), [&](const Line& line) { parsed.push_back(line); });
+	BOOST_REQUIRE_EQUAL(parsed.size(), lines.size());
+
+	USTimeConverter converter;
+	for (size_t i = 0; i < lines.size(); ++i)
+	{
+		Line line;
+		ReadSysInternalsLogFileMessage(lines[i], line, converter);
+		BOOST_REQUIRE_EQUAL(parsed[i].systemTime.dwLowDateTime, line.systemTime.dwLowDateTime);
+		BOOST_REQUIRE_EQUAL(parsed[i].systemTime.dwHighDateTime, line.systemTime.dwHighDateTime);
+		BOOST_REQUIRE_EQUAL(parsed[i].pid, line.pid);
+		BOOST_REQUIRE_EQUAL(file.GetText(i), "message " + std::to_string(static_cast<long long>(i)));
+	}
+}
+
+// the istringstream based parsing that TimeParser replaces, kept as a reference for TimeParserBenchmark
+bool ReadTimeOfDayStream(const std::string& text, USTime& time)
+{
+	{
+		std::istringstream is(text);
+		char c1, c2, d1, p1, p2;
+		if ((is >> time.hour >> c1 >> time.minute >> c2 >> time.second >> d1 >> time.milliseconds) && c1 == ':' && c2 == ':' && d1 == '.')
+		{
+			if (time.hour == 12)
+				time.hour = 0;
+			if (is >> p1 >> p2 && p1 == 'P' && p2 == 'M')
+				time.hour += 12;
+			return true;
+		}
+	}
+
+	std::istringstream is(text);
+	char c1, c2, p1, p2;
+	if (!((is >> time.hour >> c1 >> time.minute >> c2 >> time.second) && c1 == ':' && c2 == ':'))
+		return false;
+	if (time.hour == 12)
+		time.hour = 0;
+	if (is >> p1 >> p2 && p1 == 'P' && p2 == 'M')
+		time.hour += 12;
+	time.milliseconds = 0;
+	return true;
+}
+
+BOOST_AUTO_TEST_CASE(TimeParserBenchmark)
+{
+	const int count = 100000;
+	const char* formats[] = { "hh:MM:SS.mmm tt", "hh:MM:SS tt", "HH:MM:SS.mmm", "HH:MM:SS" };
+
+	for (int f = 0; f < 4; ++f)
+	{
+		bool usRegion = f < 2;
+		bool ms = f % 2 == 0;
+
+		std::vector<std::string> texts;
+		std::vector<USTime> expected;
+		for (int i = 0; i < count; ++i)
+		{
+			int seconds = i * 7;
+			USTime time = { static_cast<WORD>(seconds / 3600 % 24), static_cast<WORD>(seconds / 60 % 60), static_cast<WORD>(seconds % 60), static_cast<WORD>(ms ? i % 1000 : 0) };
+			expected.push_back(time);
+
+			char buf[32];
+			int h = usRegion ? (time.hour % 12 == 0 ? 12 : time.hour % 12) : time.hour;
+			int n = sprintf_s(buf, "%02d:%02d:%02d", h, time.minute, time.second);
+			if (ms)
+				n += sprintf_s(buf + n, sizeof(buf) - n, ".%03d", time.milliseconds);
+			if (usRegion)
+				sprintf_s(buf + n, sizeof(buf) - n, " %s", time.hour < 12 ? "AM" : "PM");
+			texts.push_back(buf);
+		}
+
+		Timer timer;
+		timer.Get();
+		unsigned streamSum = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			USTime time;
+			if (ReadTimeOfDayStream(texts[i], time))
+				streamSum += time.second;
+		}
+		double streamTime = timer.Get();
+
+		timer.Reset();
+		timer.Get();
+		auto format = DetectTimeFormat(texts[0]);
+		unsigned parserSum = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			USTime time;
+			BOOST_REQUIRE(ParseTimeOfDay(texts[i], format, time));
+			BOOST_REQUIRE_EQUAL(time.hour, expected[i].hour);
+			BOOST_REQUIRE_EQUAL(time.minute, expected[i].minute);
+			BOOST_REQUIRE_EQUAL(time.second, expected[i].second);
+			BOOST_REQUIRE_EQUAL(time.milliseconds, expected[i].milliseconds);
+			parserSum += time.second;
+		}
+		double parserTime = timer.Get();
+
+		BOOST_REQUIRE_EQUAL(streamSum, parserSum);
+		BOOST_MESSAGE(formats[f] << ": istringstream " << streamTime << " s, TimeParser " << parserTime << " s for " << count << " lines");
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TimeParserFormats)
+{
+	BOOST_REQUIRE_EQUAL(DetectTimeFormat("10:20:30.456 PM"), TimeFormat::USRegionMs);
+	BOOST_REQUIRE_EQUAL(DetectTimeFormat("10:20:30 AM"), TimeFormat::USRegion);
+	BOOST_REQUIRE_EQUAL(DetectTimeFormat("22:20:30.456"), TimeFormat::LocalMs);
+	BOOST_REQUIRE_EQUAL(DetectTimeFormat("22:20:30"), TimeFormat::Local);
+	BOOST_REQUIRE_EQUAL(DetectTimeFormat("12.345678"), TimeFormat::Relative);
+	BOOST_REQUIRE_EQUAL(DetectTimeFormat("25:20:30"), TimeFormat::Unknown);
+	BOOST_REQUIRE_EQUAL(DetectTimeFormat("message"), TimeFormat::Unknown);
+
+	USTime time;
+	BOOST_REQUIRE(ParseTimeOfDay("12:00:01 AM", TimeFormat::USRegion, time));
+	BOOST_REQUIRE_EQUAL(time.hour, 0);
+	BOOST_REQUIRE(ParseTimeOfDay("12:00:01", TimeFormat::Local, time));
+	BOOST_REQUIRE_EQUAL(time.hour, 12);
+	BOOST_REQUIRE(!ParseTimeOfDay("12:00:01.123", TimeFormat::Local, time));
+
+	double relative;
+	BOOST_REQUIRE(ParseRelativeTime("1234.567890", relative));
+	BOOST_REQUIRE_EQUAL(relative, 1234.567890);
+	BOOST_REQUIRE(!ParseRelativeTime("1234.5x", relative));
+
+	SYSTEMTIME st;
+	BOOST_REQUIRE(ParseDateTime("2014/03/15 10:20:30.456", st));
+	BOOST_REQUIRE_EQUAL(st.wYear, 2014);
+	BOOST_REQUIRE_EQUAL(st.wMilliseconds, 456);
+	BOOST_REQUIRE(!ParseDateTime("2014/13/15 10:20:30.456", st));
+}
+
+BOOST_AUTO_TEST_CASE(TimestampFormatterText)
+{
+	TimestampFormatter formatter;
+	char buf[TimestampFormatter::offsetSize];
+
+	// steps of 0.123457 seconds cross many second, minute and day boundaries
+	ULARGE_INTEGER t;
+	auto ft = Win32::GetSystemTimeAsFileTime();
+	t.LowPart = ft.dwLowDateTime;
+	t.HighPart = ft.dwHighDateTime;
+	for (int i = 0; i < 100000; ++i)
+	{
+		t.QuadPart += 1234570;
+		ft.dwLowDateTime = t.LowPart;
+		ft.dwHighDateTime = t.HighPart;
+		BOOST_REQUIRE_EQUAL(std::string(buf, formatter.FormatDateTime(ft, buf)), GetDateTimeText(ft));
+		BOOST_REQUIRE_EQUAL(std::string(buf, formatter.FormatTime(ft, buf)), GetTimeText(ft));
+		BOOST_REQUIRE_EQUAL(formatter.FormatDate(ft), GetDateText(ft));
+	}
+
+	for (int i = 0; i < 100000; ++i)
+	{
+		double time = i * 0.7234567;
+		char expected[TimestampFormatter::offsetSize];
+		sprintf_s(expected, "%.06f", time);
+		BOOST_REQUIRE_EQUAL(std::string(buf, TimestampFormatter::FormatOffset(time, buf)), expected);
+	}
+	BOOST_REQUIRE_EQUAL(std::string(buf, TimestampFormatter::FormatOffset(-1.5, buf)), "-1.500000");
+}
+
+BOOST_AUTO_TEST_CASE(ReadLogFileMessageInvalidDate)
+{
+	Line line;
+	BOOST_REQUIRE(ReadLogFileMessage("1.5\tnot a date\t42\tprocess.exe\thello\tworld", line));
+	BOOST_REQUIRE_EQUAL(line.time, 1.5);
+	BOOST_REQUIRE_EQUAL(line.systemTime.dwLowDateTime, 0u);
+	BOOST_REQUIRE_EQUAL(line.systemTime.dwHighDateTime, 0u);
+	BOOST_REQUIRE_EQUAL(line.pid, 42u);
+	BOOST_REQUIRE_EQUAL(line.processName, "process.exe");
+	BOOST_REQUIRE_EQUAL(line.message, "hello\tworld");
+}
+
+BOOST_AUTO_TEST_CASE(FileWriterWritesAllLines)
+{
+	auto filename = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("%%%%-%%%%-%%%%.dblog");
+	auto guard = make_guard([&]() { boost::filesystem::remove(filename); });
+
+	const int count = 50000;
+	LogFile logFile;
+	{
+		// lines are added while the writer is writing, the destructor writes the remaining lines
+		FileWriter writer(filename.wstring(), logFile, FlushPolicy(FlushPolicy::Size, 64 * 1024));
+		for (int i = 0; i < count; ++i)
+		{
+			logFile.Add(Message(i, Win32::GetSystemTimeAsFileTime(), i % 10, "processname", GetTestString(i) + "\r\n"));
+			writer.Notify();
+		}
+	}
+
+	std::ifstream file(filename.string());
+	Line line;
+	int lines = 0;
+	while (ReadLogFileMessage(file, line))
+	{
+		BOOST_REQUIRE_EQUAL(line.message, GetTestString(lines));
+		BOOST_REQUIRE_EQUAL(line.pid, static_cast<DWORD>(lines % 10));
+		++lines;
+	}
+	BOOST_REQUIRE_EQUAL(lines, count);
+}
+
+BOOST_AUTO_TEST_CASE(FilterEngineRequiredLiterals)
+{
+	bool exact;
+	BOOST_REQUIRE_EQUAL(RequiredLiteral("Hello World", MatchType::Simple, exact), "hello world");
+	BOOST_REQUIRE(exact);
+	BOOST_REQUIRE_EQUAL(RequiredLiteral("Hello*World?x", MatchType::Wildcard, exact), "hello");
+	BOOST_REQUIRE(!exact);
+	BOOST_REQUIRE_EQUAL(RequiredLiteral("a(bcd)?ef+", MatchType::Regex, exact), "ef");
+	BOOST_REQUIRE_EQUAL(RequiredLiteral("\\d+ apples\\.", MatchType::Regex, exact), " apples.");
+	BOOST_REQUIRE_EQUAL(RequiredLiteral("[abc]xyz", MatchType::Regex, exact), "xyz");
+	BOOST_REQUIRE_EQUAL(RequiredLiteral("error|warning", MatchType::Regex, exact), "");
+
+	MultiLiteralMatcher matcher;
+	matcher.Add("he", 0);
+	matcher.Add("she", 1);
+	matcher.Add("his", 2);
+	matcher.Add("HERS", 3);
+	matcher.Compile();
+	std::vector<unsigned char> found(4);
+	matcher.Find("uSHErs", found);
+	BOOST_REQUIRE(found[0] && found[1] && !found[2] && found[3]);
+}
+
+BOOST_AUTO_TEST_CASE(FilterEngineMatchesRegexSearch)
+{
+	std::vector<Filter> filters;
+	const char* texts[] = { "ab", "B", "abc", "bca", "cab", "aa", "", "x.", "a*b", "c?a", "AbC" };
+	for (size_t i = 0; i < sizeof(texts)/sizeof(texts[0]); ++i)
+	{
+		filters.push_back(Filter(texts[i], MatchType::Simple, FilterType::Include));
+		filters.push_back(Filter(texts[i], MatchType::Wildcard, FilterType::Exclude));
+	}
+	const char* regexes[] = { "a+b", "ab*c", "(ab)+c", "^ab", "c$", "[ab]c", "a.c", "x|y", "\\.", "b{2}", "ab?c" };
+	for (size_t i = 0; i < sizeof(regexes)/sizeof(regexes[0]); ++i)
+		filters.push_back(Filter(regexes[i], MatchType::Regex, FilterType::Highlight));
+	filters[3].enable = false;
+
+	FilterEngine engine(filters);
+	FilterMatch match;
+	std::mt19937 generator(1);
+	for (int i = 0; i < 20000; ++i)
+	{
+		std::string text;
+		int size = generator() % 12;
+		for (int j = 0; j < size; ++j)
+			text += "abcABx. "[generator() % 8];
+
+		engine.Match(filters, text, match);
+		for (size_t f = 0; f < filters.size(); ++f)
+			BOOST_REQUIRE_EQUAL(match.filters[f] != 0, filters[f].enable && std::regex_search(text, filters[f].pattern->re));
+		BOOST_REQUIRE_EQUAL(match.Matched(FilterType::Include), MatchFilterType(filters, FilterType::Include, text));
+		BOOST_REQUIRE_EQUAL(match.Matched(FilterType::Exclude), MatchFilterType(filters, FilterType::Exclude, text));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(FilterCacheMatchesFilterEngine)
+{
+	std::vector<Filter> filters;
+	filters.push_back(Filter("svchost", MatchType::Simple, FilterType::Exclude));
+	filters.push_back(Filter("proc[13]", MatchType::Regex, FilterType::Include));
+	filters.push_back(Filter("*.exe", MatchType::Wildcard, FilterType::Highlight));
+	filters[2].enable = false;
+
+	FilterEngine engine(filters);
+	FilterCache cache;
+	FilterMatch match;
+	FilterMatch cached;
+	ProcessInfo processInfo;
+	std::mt19937 generator(1);
+	for (int i = 0; i < 10000; ++i)
+	{
+		DWORD pid = generator() % 300;
+		std::string name = generator() % 4 == 0 ? std::string("svchost.exe") : (stringbuilder() << "proc" << pid % 5 << ".exe").str();
+		auto uid = processInfo.GetUid(pid, WStr(name).str());
+		BOOST_REQUIRE_EQUAL(processInfo.GetUid(pid, WStr(name).str()), uid);
+		BOOST_REQUIRE_EQUAL(processInfo.GetProcessProperties(uid).pid, pid);
+
+		engine.Match(filters, name, match);
+		engine.Match(filters, cache, uid, name, cached);
+		BOOST_REQUIRE(cached.filters == match.filters);
+		BOOST_REQUIRE_EQUAL(cached.types, match.types);
+	}
+}
+
+// lines as written by DbgMsgSrc
+std::vector<std::string> GetDbgMsgSrcCorpus()
+{
+	const char* lines[] =
+	{
+		"Een, twee, drie, vier, vijf, zes, zeven, acht, negen, tien, elf, twaalf, dertien, veertien, vijftien, zestien, zeventien, achttien, negentien, twintig.",
+		"Message 1 without newline",
+		"Message with",
+		"embedded newline",
+		"This should look like a table in a non-proportionally spaced font like 'Courier'",
+		"Columnn1\tColumnn2\tColumnn3\tColumnn4\tColumnn5",
+		"21\t\t22\t\t23A\t\t24\t\t25",
+		"   This line has 3 space prefixed",
+		"HighLighting test: Double-click the word 'lines' in each of the following lines and make sure that word is highlighted.",
+		"  \t123\t  \t123\t  \t123\t  \t123\t This lines starts with 2 spaces + tab",
+		"Message without newline    (tid: 9002)",
+		"Message without newline  (address: 0xDEADBEEF)",
+		"Message without newline     (address: 0xBAADF00D)"
+	};
+
+	std::vector<std::string> corpus;
+	for (int i = 0; i < 10000; ++i)
+	{
+		corpus.push_back(lines[i % (sizeof(lines)/sizeof(lines[0]))]);
+		corpus.push_back(stringbuilder() << "Message #" << i);
+	}
+	return corpus;
+}
+
+BOOST_AUTO_TEST_CASE(FilterPatternsAreShared)
+{
+	Filter filter("error [0-9]+", MatchType::Regex, FilterType::Include);
+	LogFilter logFilter;
+	logFilter.messageFilters.push_back(filter);
+	LogFilter copy = logFilter;
+	BOOST_REQUIRE(copy.messageFilters[0].pattern == filter.pattern);
+
+	// the same text and MatchType give the same pattern, another MatchType compiles another pattern
+	Filter same("error [0-9]+", MatchType::Regex, FilterType::Exclude, RGB(255, 0, 0));
+	BOOST_REQUIRE(same.pattern == filter.pattern);
+	Filter simple("error [0-9]+", MatchType::Simple, FilterType::Include);
+	BOOST_REQUIRE(simple.pattern != filter.pattern);
+	BOOST_REQUIRE(IsMatch(filter, "Error 42"));
+	BOOST_REQUIRE(!IsMatch(simple, "Error 42"));
+	BOOST_REQUIRE(IsMatch(simple, "an error [0-9]+ text"));
+
+	// a pattern that is no longer used is compiled again
+	boost::weak_ptr<const FilterPattern> unused = Filter("unused", MatchType::Regex, FilterType::Include).pattern;
+	BOOST_REQUIRE(unused.expired());
+	BOOST_REQUIRE(IsMatch(Filter("unused", MatchType::Regex, FilterType::Include), "UNUSED"));
+
+	BOOST_REQUIRE_THROW(Filter("(", MatchType::Regex, FilterType::Include), std::regex_error);
+}
+
+BOOST_AUTO_TEST_CASE(LiteralMatcherMatchesRegexSearch)
+{
+	BOOST_REQUIRE_EQUAL(FindNoCase("0123456789abcdefghijklmnopqrstuvwxyzDEADBEEF", "deadbeef"), 36);
+	BOOST_REQUIRE_EQUAL(FindNoCase("Message #1", "message", 1), std::string::npos);
+
+	std::mt19937 generator(1);
+	for (int i = 0; i < 20000; ++i)
+	{
+		std::string pattern;
+		int size = generator() % 6;
+		for (int j = 0; j < size; ++j)
+			pattern += "abAB*?."[generator() % 7];
+		auto matchType = generator() % 2 == 0 ? MatchType::Simple : MatchType::Wildcard;
+
+		std::string text;
+		size = generator() % 40;
+		for (int j = 0; j < size; ++j)
+			text += "abcAB.\n*?"[generator() % 9];
+
+		LiteralMatcher matcher(pattern, matchType);
+		BOOST_REQUIRE(matcher.IsLiteral());
+		BOOST_REQUIRE_EQUAL(matcher.Search(text), std::regex_search(text, std::regex(MakePattern(matchType, pattern), std::regex_constants::icase)));
+	}
+
+	BOOST_REQUIRE(!LiteralMatcher("caf\xe9", MatchType::Simple).IsLiteral());
+	BOOST_REQUIRE(!LiteralMatcher("a.*b", MatchType::Regex).IsLiteral());
+}
+
+BOOST_AUTO_TEST_CASE(LiteralMatcherBenchmark)
+{
+	auto corpus = GetDbgMsgSrcCorpus();
+	const char* patterns[] = { "newline", "DEADBEEF", "no such text", "tid: 900?", "message*address*0x", "line*starts*tab" };
+	MatchType::type matchTypes[] = { MatchType::Simple, MatchType::Simple, MatchType::Simple, MatchType::Wildcard, MatchType::Wildcard, MatchType::Wildcard };
+
+	for (int p = 0; p < 6; ++p)
+	{
+		Filter filter(patterns[p], matchTypes[p], FilterType::Include);
+		BOOST_REQUIRE(filter.pattern->literal.IsLiteral());
+
+		Timer timer;
+		timer.Get();
+		int regexCount = 0;
+		for (auto it = corpus.begin(); it != corpus.end(); ++it)
+			regexCount += std::regex_search(*it, filter.pattern->re);
+		double regexTime = timer.Get();
+
+		timer.Reset();
+		timer.Get();
+		int literalCount = 0;
+		for (auto it = corpus.begin(); it != corpus.end(); ++it)
+			literalCount += IsMatch(filter, *it);
+		double literalTime = timer.Get();
+
+		BOOST_REQUIRE_EQUAL(regexCount, literalCount);
+		BOOST_MESSAGE(MatchTypeToString(matchTypes[p]) << " '" << patterns[p] << "': std::regex " << regexTime << " s, LiteralMatcher " << literalTime << " s for " << corpus.size() << " lines");
+	}
+}
+
+std::vector<int> ApplySequentialFilter(const LogFile& logFile, LogFilter& filter, size_t begin, MatchColors& matchColors)
+{
+	std::vector<int> lines;
+	LogFilterEngine engine(filter);
+	LogFilterMatch match;
+	for (size_t i = begin; i < logFile.EndIndex(); ++i)
+	{
+		auto msg = logFile[i];
+		engine.Match(filter, msg.processName, msg.text, match);
+		if (IsIncluded(filter.processFilters, match.process, msg.processName, matchColors) &&
+			IsIncluded(filter.messageFilters, match.message, msg.text, matchColors))
+			lines.push_back(static_cast<int>(i));
+	}
+	return lines;
+}
+
+std::vector<int> ApplyParallelFilter(const LogFile& logFile, LogFilter& filter, size_t begin, MatchColors& matchColors)
+{
+	std::vector<int> lines;
+	ParallelFilter pass(logFile, filter, begin, logFile.EndIndex());
+	while (!pass.Done())
+	{
+		pass.Poll([&](const FilteredBlock& block)
+		{
+			auto verdict = block.verdicts.begin();
+			for (auto it = block.lines.begin(); it != block.lines.end(); ++it)
+			{
+				if (!it->stateful || ReduceLogFilterVerdict(filter, *verdict++, matchColors))
+					lines.push_back(it->line);
+			}
+		});
+	}
+	BOOST_REQUIRE_EQUAL(pass.Progress(), 100);
+	return lines;
+}
+
+BOOST_AUTO_TEST_CASE(ParallelFilterMatchesSequentialFilter)
+{
+	auto corpus = GetDbgMsgSrcCorpus();
+	LogFile logFile;
+	auto t = Win32::GetSystemTimeAsFileTime();
+	for (size_t i = 0; i < corpus.size(); ++i)
+		logFile.Add(Message(static_cast<double>(i), t, static_cast<DWORD>(i % 7), i % 3 == 0 ? "DbgMsgSrc.exe" : "other.exe", corpus[i]));
+
+	LogFilter filter;
+	filter.messageFilters.push_back(Filter("message", MatchType::Simple, FilterType::Include));
+	filter.messageFilters.push_back(Filter("newline", MatchType::Simple, FilterType::Include));
+	filter.messageFilters.push_back(Filter("#[0-9]*7$", MatchType::Regex, FilterType::Exclude));
+	filter.processFilters.push_back(Filter("other", MatchType::Simple, FilterType::Exclude));
+
+	auto sequentialFilter = filter;
+	MatchColors sequentialColors;
+	auto sequential = ApplySequentialFilter(logFile, sequentialFilter, 1234, sequentialColors);
+
+	auto parallelFilter = filter;
+	MatchColors parallelColors;
+	auto parallel = ApplyParallelFilter(logFile, parallelFilter, 1234, parallelColors);
+
+	BOOST_REQUIRE_GT(sequential.size(), 0);
+	BOOST_REQUIRE(parallel == sequential);
+}
+
+BOOST_AUTO_TEST_CASE(ParallelFilterReducesStatefulFilters)
+{
+	const char* words[] = { "alpha", "beta", "gamma", "delta", "error", "warning", "once", "Once" };
+	std::mt19937 generator(1);
+	LogFile logFile;
+	auto t = Win32::GetSystemTimeAsFileTime();
+	for (int i = 0; i < 50000; ++i)
+	{
+		std::string text;
+		int size = 1 + generator() % 4;
+		for (int j = 0; j < size; ++j)
+			text += (stringbuilder() << words[generator() % 8] << " id=" << generator() % 500 << " ").str();
+		logFile.Add(Message(i, t, i % 5, stringbuilder() << "proc" << generator() % 6 << ".exe", text));
+	}
+
+	LogFilter filter;
+	filter.messageFilters.push_back(Filter("error|warning", MatchType::Regex, FilterType::Include));
+	filter.messageFilters.push_back(Filter("once id=1?", MatchType::Wildcard, FilterType::Once));
+	filter.messageFilters.push_back(Filter("id=([0-9]+)", MatchType::RegexGroups, FilterType::Token, Colors::Auto));
+	filter.messageFilters.push_back(Filter("gamma", MatchType::Simple, FilterType::Highlight, Colors::Auto));
+	filter.messageFilters.push_back(Filter("*delta id=3*", MatchType::Wildcard, FilterType::Exclude));
+	filter.processFilters.push_back(Filter("proc[0-9]", MatchType::Regex, FilterType::Highlight, Colors::Auto));
+	filter.processFilters.push_back(Filter("proc5", MatchType::Simple, FilterType::Exclude));
+	filter.processFilters.push_back(Filter("proc4", MatchType::Simple, FilterType::Once));
+
+	auto sequentialFilter = filter;
+	MatchColors sequentialColors;
+	auto sequential = ApplySequentialFilter(logFile, sequentialFilter, 0, sequentialColors);
+
+	auto parallelFilter = filter;
+	MatchColors parallelColors;
+	auto parallel = ApplyParallelFilter(logFile, parallelFilter, 0, parallelColors);
+
+	BOOST_REQUIRE_GT(sequential.size(), 0);
+	BOOST_REQUIRE(parallel == sequential);
+	BOOST_REQUIRE_GT(sequentialColors.size(), 500);
+	BOOST_REQUIRE(parallelColors == sequentialColors);
+	for (size_t i = 0; i < filter.messageFilters.size(); ++i)
+		BOOST_REQUIRE_EQUAL(parallelFilter.messageFilters[i].matched, sequentialFilter.messageFilters[i].matched);
+	for (size_t i = 0; i < filter.processFilters.size(); ++i)
+		BOOST_REQUIRE_EQUAL(parallelFilter.processFilters[i].matched, sequentialFilter.processFilters[i].matched);
+}
+
+BOOST_AUTO_TEST_CASE(TrigramIndexCandidateBlocks)
+{
+	const size_t blocks = 10;
+	const int rareLine = 1234;
+	LogFile logFile;
+	TrigramIndex index(logFile);
+	auto t = Win32::GetSystemTimeAsFileTime();
+	for (int i = 0; i < static_cast<int>(blocks * indexedstorage::blockSize) + 5; ++i)
+	{
+		logFile.Add(Message(i, t, 0, "processname", i == rareLine ? std::string("a Rare Token") : GetTestString(i)));
+		index.Notify();
+	}
+
+	for (int i = 0; i < 1000 && index.Size() < blocks; ++i)
+		boost::this_thread::sleep_for(boost::chrono::milliseconds(10));
+	BOOST_REQUIRE_EQUAL(index.Size(), blocks);
+
+	// a line that contains the text is never rejected, folding case like Find
+	const char* texts[] = { "rare TOKEN", "test_abc", "_12", "efghi_ee_399" };
+	for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); ++i)
+	{
+		auto query = index.Query(texts[i]);
+		for (size_t line = logFile.BeginIndex(); line < logFile.EndIndex(); ++line)
+		{
+			auto text = logFile.GetText(line).str();
+			if (!boost::algorithm::ifind_first(text, texts[i]).empty())
+				BOOST_REQUIRE(query.MayContain(line));
+		}
+	}
+
+	auto query = index.Query("rare token");
+	size_t candidates = 0;
+	for (size_t block = 0; block < blocks; ++block)
+		candidates += query.MayContain(block * indexedstorage::blockSize);
+	BOOST_REQUIRE_EQUAL(candidates, 1);
+	BOOST_REQUIRE(query.MayContain(rareLine));
+
+	// texts without trigrams and the lines that are not indexed yet are always candidates
+	BOOST_REQUIRE(index.Query("ra").MayContain(0));
+	BOOST_REQUIRE(query.MayContain(logFile.EndIndex() - 1));
+
+	logFile.Clear();
+	index.Clear();
+	BOOST_REQUIRE_EQUAL(index.Size(), 0);
+	BOOST_REQUIRE(index.Query("rare token").MayContain(0));
+}
+
+std::vector<int> SearchLines(const LogFile& logFile, const Filter& filter)
+{
+	std::vector<int> lines;
+	for (size_t line = logFile.BeginIndex(); line < logFile.EndIndex(); ++line)
+	{
+		if (IsMatch(filter, logFile.GetText(line).str().to_string()))
+			lines.push_back(static_cast<int>(line));
+	}
+	return lines;
+}
+
+std::vector<int> GetMatches(const LogSearch& search)
+{
+	std::vector<int> lines;
+	for (size_t i = 0; i < search.Count(); ++i)
+		lines.push_back(search.GetMatch(i));
+	return lines;
+}
+
+BOOST_AUTO_TEST_CASE(LogSearchStreamsMatches)
+{
+	LogFile logFile;
+	TrigramIndex index(logFile);
+	auto t = Win32::GetSystemTimeAsFileTime();
+	for (int i = 0; i < 20000; ++i)
+		logFile.Add(Message(i, t, 0, "processname", GetTestString(i)));
+	index.Notify();
+
+	const char* texts[] = { "ee_12", "_1?3$" };
+	MatchType::type matchTypes[] = { MatchType::Simple, MatchType::Regex };
+	for (int i = 0; i < 2; ++i)
+	{
+		int updates = 0;
+		LogSearch search(logFile, index, texts[i], matchTypes[i], [&updates]() { ++updates; });
+		BOOST_REQUIRE(GuiWaitFor([&search]() { return search.Done(); }));
+		Filter filter(texts[i], matchTypes[i], FilterType::Include);
+		auto expected = SearchLines(logFile, filter);
+		BOOST_REQUIRE(GetMatches(search) == expected);
+		BOOST_REQUIRE_GT(updates, 0);
+
+		// lines that are added later are searched without searching the others again
+		for (int j = 20000; j < 21000; ++j)
+			logFile.Add(Message(j, t, 0, "processname", GetTestString(j)));
+		search.Notify();
+		BOOST_REQUIRE(GuiWaitFor([&search]() { return search.Done(); }));
+		expected = SearchLines(logFile, filter);
+		BOOST_REQUIRE(GetMatches(search) == expected);
+		BOOST_REQUIRE_EQUAL(search.Next(expected.front()), expected[1]);
+		BOOST_REQUIRE_EQUAL(search.Previous(expected.back()), expected[expected.size() - 2]);
+		BOOST_REQUIRE_EQUAL(search.Next(expected.back()), -1);
+		BOOST_REQUIRE_EQUAL(search.Previous(expected.front()), -1);
+	}
+}
+
 BOOST_AUTO_TEST_CASE(TimeZone)
 {
 	Timer timer;
@@ -275,6 +1027,172 @@ BOOST_AUTO_TEST_CASE(LineBufferTest2)
 	}
 }
 
+BOOST_AUTO_TEST_CASE(CircularLineBufferMultipleProducers)
+{
+	const int producers = 4;
+	const int count = 20000;
+
+	// a small ring makes the producers wrap around and wait while the consumer drains
+	CircularLineBuffer buffer(4096, OverflowPolicy::Block);
+	boost::atomic<int> running(producers);
+	boost::thread_group threads;
+	for (int p = 0; p < producers; ++p)
+	{
+		threads.create_thread([&, p]()
+		{
+			FILETIME ft = FILETIME();
+			for (int i = 0; i < count; ++i)
+				buffer.Add(i, ft, p, "producer", GetTestString(i), nullptr);
+			--running;
+		});
+	}
+
+	std::vector<int> next(producers, 0);
+	for (;;)
+	{
+		bool done = running == 0;
+		auto lines = buffer.GetLines();
+		for (auto it = lines.begin(); it != lines.end(); ++it)
+		{
+			BOOST_REQUIRE_LT(it->pid, static_cast<DWORD>(producers));
+			int& i = next[it->pid];
+			BOOST_REQUIRE_EQUAL(it->time, i);
+			BOOST_REQUIRE_EQUAL(it->processName, "producer");
+			BOOST_REQUIRE_EQUAL(it->message, GetTestString(i));
+			++i;
+		}
+		if (done && buffer.Empty())
+			break;
+	}
+	threads.join_all();
+
+	for (int p = 0; p < producers; ++p)
+		BOOST_REQUIRE_EQUAL(next[p], count);
+	BOOST_REQUIRE_EQUAL(buffer.GetCounters().added, static_cast<size_t>(producers * count));
+	BOOST_REQUIRE_EQUAL(buffer.GetCounters().dropped, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(CircularLineBufferOverflow)
+{
+	FILETIME ft = FILETIME();
+	CircularLineBuffer dropBuffer(512, OverflowPolicy::DropNewest);
+	for (int i = 0; i < 100; ++i)
+		dropBuffer.Add(i, ft, 1, "process", GetTestString(i), nullptr);
+
+	// the kept lines are followed by the "N lines dropped" line
+	auto lines = dropBuffer.GetLines();
+	BOOST_REQUIRE_GT(lines.size(), 1u);
+	size_t kept = lines.size() - 1;
+	size_t dropped = dropBuffer.GetCounters().dropped;
+	BOOST_REQUIRE_EQUAL(kept + dropped, 100u);
+	BOOST_REQUIRE_EQUAL(dropBuffer.GetCounters().added, kept);
+	for (size_t i = 0; i < kept; ++i)
+	{
+		BOOST_REQUIRE_EQUAL(lines[i].processName, "process");
+		BOOST_REQUIRE_EQUAL(lines[i].message, GetTestString(i));
+	}
+	BOOST_REQUIRE_EQUAL(lines.back().message, GetDroppedLinesMessage(dropped));
+	BOOST_REQUIRE(dropBuffer.Empty());
+
+	// the newest lines are kept
+	dropBuffer.SetPolicy(OverflowPolicy::DropOldest);
+	for (int i = 0; i < 100; ++i)
+		dropBuffer.Add(i, ft, 1, "process", GetTestString(i), nullptr);
+	lines = dropBuffer.GetLines();
+	BOOST_REQUIRE(!lines.empty());
+	for (size_t i = 0; i < lines.size(); ++i)
+		BOOST_REQUIRE_EQUAL(lines[i].message, GetTestString(static_cast<int>(100 - lines.size() + i)));
+	BOOST_REQUIRE_EQUAL(dropBuffer.GetCounters().dropped, dropped + 100 - lines.size());
+
+	// a blocked producer continues when the consumer takes the lines
+	CircularLineBuffer blockBuffer(512, OverflowPolicy::Block);
+	const int count = 10000;
+	boost::thread producer([&]()
+	{
+		for (int i = 0; i < count; ++i)
+			blockBuffer.Add(i, ft, 1, "process", GetTestString(i), nullptr);
+	});
+
+	int received = 0;
+	while (received < count)
+	{
+		auto lines = blockBuffer.GetLines();
+		for (auto it = lines.begin(); it != lines.end(); ++it)
+		{
+			BOOST_REQUIRE_EQUAL(it->message, GetTestString(received));
+			++received;
+		}
+	}
+	producer.join();
+	BOOST_REQUIRE_EQUAL(blockBuffer.GetCounters().dropped, 0u);
+	BOOST_REQUIRE_EQUAL(blockBuffer.GetCounters().added, static_cast<size_t>(count));
+}
+
+BOOST_AUTO_TEST_CASE(CircularLineBufferDropClosesHandles)
+{
+	// DBWinReader queues a process handle with each line, the handles of the dropped lines must be closed
+	FILETIME ft = FILETIME();
+	for (int policy = OverflowPolicy::DropOldest; policy <= OverflowPolicy::DropNewest; ++policy)
+	{
+		// all handles exist before the first one is closed, so no handle value is reused by the test
+		std::vector<HANDLE> handles;
+		for (int i = 0; i < 100; ++i)
+			handles.push_back(::CreateEvent(nullptr, FALSE, FALSE, nullptr));
+
+		CircularLineBuffer buffer(512, static_cast<OverflowPolicy::type>(policy));
+		for (int i = 0; i < 100; ++i)
+			buffer.Add(i, ft, handles[i], GetTestString(i), nullptr);
+		auto lines = buffer.GetLines();
+
+		size_t closed = 0;
+		for (auto it = handles.begin(); it != handles.end(); ++it)
+		{
+			bool queued = false;
+			for (auto line = lines.begin(); line != lines.end(); ++line)
+				queued = queued || line->handle == *it;
+
+			DWORD flags;
+			BOOST_REQUIRE_EQUAL(::GetHandleInformation(*it, &flags) != FALSE, queued);
+			if (queued)
+				::CloseHandle(*it);
+			else
+				++closed;
+		}
+		BOOST_REQUIRE_GT(closed, 0u);
+		BOOST_REQUIRE_EQUAL(closed, buffer.GetCounters().dropped);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(PassiveLogSourceLimit)
+{
+	Timer timer;
+	CircularLineBuffer buffer(64 * 1024, OverflowPolicy::Block);
+	Loopback loopback(timer, buffer);
+	loopback.SetLimit(10, OverflowPolicy::DropNewest);
+	for (int i = 0; i < 25; ++i)
+		loopback.AddMessage(1, "process", GetTestString(i));
+	loopback.Notify();
+
+	auto lines = buffer.GetLines();
+	BOOST_REQUIRE_EQUAL(lines.size(), 11u);
+	for (int i = 0; i < 10; ++i)
+		BOOST_REQUIRE_EQUAL(lines[i].message, GetTestString(i));
+	BOOST_REQUIRE_EQUAL(lines[10].message, GetDroppedLinesMessage(15));
+
+	loopback.SetLimit(10, OverflowPolicy::DropOldest);
+	for (int i = 0; i < 25; ++i)
+		loopback.AddMessage(1, "process", GetTestString(i));
+	loopback.Notify();
+	lines = buffer.GetLines();
+	BOOST_REQUIRE_EQUAL(lines.size(), 10u);
+	BOOST_REQUIRE_EQUAL(lines.front().message, GetTestString(15));
+
+	auto counters = loopback.GetCounters();
+	BOOST_REQUIRE_EQUAL(counters.added, 35u);
+	BOOST_REQUIRE_EQUAL(counters.dropped, 30u);
+	BOOST_REQUIRE_EQUAL(counters.peak, 10u);
+}
+
 BOOST_AUTO_TEST_CASE(IndexedStorageRandomAccess)
 {
 	using namespace indexedstorage;
@@ -295,6 +1213,127 @@ BOOST_AUTO_TEST_CASE(IndexedStorageRandomAccess)
 	}
 }
 
+BOOST_AUTO_TEST_CASE(IndexedStorageStringRef)
+{
+	using namespace indexedstorage;
+
+	size_t testSize = 1000;
+	SnappyStorage s;
+	for (size_t i = 0; i < testSize; ++i)
+		s.Add(i % 7 == 0 ? std::string() : GetTestString(i));
+
+	BOOST_REQUIRE_EQUAL(s.Count(), testSize);
+	for (size_t i = 0; i < testSize; ++i)
+	{
+		auto ref = s.GetStringRef(i);
+		auto value = ref.str();
+		BOOST_REQUIRE_EQUAL(std::string(value.begin(), value.end()), i % 7 == 0 ? std::string() : GetTestString(i));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(IndexedStorageCache)
+{
+	using namespace indexedstorage;
+
+	SnappyStorage s;
+	for (size_t i = 0; i < 10000; ++i)
+		s.Add(GetTestString(i));
+
+	// two readers at distant positions should not evict each other's block
+	for (size_t i = 0; i < 10; ++i)
+	{
+		BOOST_REQUIRE_EQUAL(s[i], GetTestString(i));
+		BOOST_REQUIRE_EQUAL(s[5000 + i], GetTestString(5000 + i));
+	}
+	BOOST_REQUIRE_EQUAL(s.GetCacheMisses(), 2);
+	BOOST_REQUIRE_EQUAL(s.GetCacheHits(), 18);
+}
+
+BOOST_AUTO_TEST_CASE(IndexedStorageMappedFile)
+{
+	using namespace indexedstorage;
+
+	// small segments, so the blocks are spread over several segment files
+	SnappyStorage s(make_unique<MappedFileBlockStore>(L"", 64*1024), 64*1024);
+	for (size_t i = 0; i < 20000; ++i)
+		s.Add(GetTestString(i));
+
+	for (size_t i = 0; i < 20000; i += 7)
+		BOOST_REQUIRE_EQUAL(s[i], GetTestString(i));
+
+	for (size_t i = 0; i < 10; ++i)
+		s.PopFront();
+	BOOST_REQUIRE_EQUAL(s.BeginIndex(), 10 * blockSize);
+	BOOST_REQUIRE_EQUAL(s[s.BeginIndex()], GetTestString(s.BeginIndex()));
+	BOOST_REQUIRE_THROW(s[0], std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE(MappedFileBlockStoreViews)
+{
+	using namespace indexedstorage;
+
+	// the blocks span more views than the view cache holds, some cross a view boundary
+	const size_t size = 300*1024;
+	MappedFileBlockStore store(L"", 16*1024*1024);
+	for (size_t i = 0; i < 200; ++i)
+	{
+		std::string block(size, static_cast<char>('a' + i % 26));
+		store.PushBack(block.data(), block.size());
+	}
+
+	std::vector<SharedStringRef> blocks(store.EndIndex());
+	for (size_t i = 0; i < blocks.size(); ++i)
+		BOOST_REQUIRE(store.Get(i, blocks[i]));
+
+	// the blocks stay valid after their views were evicted from the cache
+	for (size_t i = 0; i < blocks.size(); ++i)
+	{
+		BOOST_REQUIRE_EQUAL(blocks[i].str().size(), size);
+		BOOST_REQUIRE_EQUAL(blocks[i].str()[0], static_cast<char>('a' + i % 26));
+		BOOST_REQUIRE_EQUAL(blocks[i].str()[size - 1], static_cast<char>('a' + i % 26));
+	}
+
+	store.PopFront();
+	SharedStringRef block;
+	BOOST_REQUIRE(!store.Get(0, block));
+	BOOST_REQUIRE(store.Get(199, block));
+}
+
+BOOST_AUTO_TEST_CASE(IndexedStorageConcurrentReaders)
+{
+	using namespace indexedstorage;
+
+	size_t testSize = 100000;
+	SnappyStorage s;
+	bool failed = false;
+	boost::atomic<bool> done(false);
+
+	boost::thread reader([&]()
+	{
+		std::default_random_engine generator;
+		while (!done)
+		{
+			auto count = s.Count();
+			if (count == 0)
+				continue;
+			std::uniform_int_distribution<size_t> distribution(0, count - 1);
+			size_t i = distribution(generator);
+			auto ref = s.GetStringRef(i);
+			auto value = ref.str();
+			if (std::string(value.begin(), value.end()) != GetTestString(i))
+				failed = true;
+		}
+	});
+
+	for (size_t i = 0; i < testSize; ++i)
+		s.Add(GetTestString(i));
+	done = true;
+	reader.join();
+
+	BOOST_REQUIRE(!failed);
+	BOOST_REQUIRE_EQUAL(s.Count(), testSize);
+}
+
 BOOST_AUTO_TEST_CASE(IndexedStorageCompression)
 {
 	using namespace indexedstorage;
@@ -328,6 +1367,72 @@ BOOST_AUTO_TEST_CASE(IndexedStorageCompression)
 	BOOST_REQUIRE_GT(0.50*usedByVector, usedBySnappy);
 }
 
+BOOST_AUTO_TEST_CASE(NewlineFilterKeepsPartialLinesPerSource)
+{
+	Timer timer;
+	VectorLineBuffer buffer(0);
+	TestSource source1(timer, buffer);
+	TestSource source2(timer, buffer);
+	source1.SetAutoNewLine(false);
+	source2.SetAutoNewLine(false);
+
+	// both sources report the same pid, their fragments must not mix
+	NewlineFilter filter;
+	Lines lines;
+	Line line1(1.0, FILETIME(), 42, "process", "first ", &source1);
+	filter.Process(line1, lines);
+	Line line2(2.0, FILETIME(), 42, "process", "second\r\nthird", &source2);
+	filter.Process(line2, lines);
+	Line line3(3.0, FILETIME(), 42, "process", "half\n", &source1);
+	filter.Process(line3, lines);
+	Line line4(4.0, FILETIME(), 42, "process", " line\n\nlast\n", &source2);
+	filter.Process(line4, lines);
+
+	BOOST_REQUIRE_EQUAL(lines.size(), 5u);
+	BOOST_REQUIRE_EQUAL(lines[0].message, "second");
+	BOOST_REQUIRE_EQUAL(lines[1].message, "first half");
+	BOOST_REQUIRE_EQUAL(lines[1].time, 3.0);
+	BOOST_REQUIRE_EQUAL(lines[2].message, "third line");
+	BOOST_REQUIRE_EQUAL(lines[3].message, "");
+	BOOST_REQUIRE_EQUAL(lines[4].message, "last");
+	for (auto it = lines.begin(); it != lines.end(); ++it)
+		BOOST_REQUIRE_EQUAL(it->processName, "process");
+
+	// a partial line longer than 8192 characters is added at once
+	lines.clear();
+	Line longLine(5.0, FILETIME(), 42, "process", std::string(9000, 'x'), &source1);
+	filter.Process(longLine, lines);
+	BOOST_REQUIRE_EQUAL(lines.size(), 1u);
+	BOOST_REQUIRE_EQUAL(lines[0].message.size(), 9000u);
+
+	// the partial line of a removed source is flushed, a new source at the same address starts without it
+	lines.clear();
+	Line partialLine(6.0, FILETIME(), 42, "process", "partial", &source1);
+	filter.Process(partialLine, lines);
+	BOOST_REQUIRE(lines.empty());
+	auto flushedLines = filter.FlushLinesFromSource(&source1);
+	BOOST_REQUIRE_EQUAL(flushedLines.size(), 1u);
+	BOOST_REQUIRE_EQUAL(flushedLines[0].message, "partial");
+	Line nextLine(7.0, FILETIME(), 42, "process", "next\n", &source1);
+	filter.Process(nextLine, lines);
+	BOOST_REQUIRE_EQUAL(lines.size(), 1u);
+	BOOST_REQUIRE_EQUAL(lines[0].message, "next");
+}
+
+// LogSources normalizes the lines on a worker thread, this waits until 'count' lines are ready
+Lines GetLines(LogSources& logsources, size_t count)
+{
+	Lines lines;
+	for (int i = 0; i < 200 && lines.size() < count; ++i)
+	{
+		auto newLines = logsources.GetLines();
+		lines.insert(lines.end(), newLines.begin(), newLines.end());
+		if (lines.size() < count)
+			Sleep(10);
+	}
+	return lines;
+}
+
 // execute as:
 // "DebugView++Test.exe" --log_level=test_suite --run_test=*/LogSourcesReceiveMessages
 BOOST_AUTO_TEST_CASE(LogSourcesReceiveMessages)
@@ -341,7 +1446,7 @@ BOOST_AUTO_TEST_CASE(LogSourcesReceiveMessages)
 	logsource->Add(timer.Get(), Win32::GetSystemTimeAsFileTime(), 0, "processname", "message 3");
 	BOOST_MESSAGE("3 lines added.");
 
-	auto lines = logsources.GetLines();
+	auto lines = GetLines(logsources, 3);
 	BOOST_MESSAGE("received: " << lines.size() << " lines.");
 
 	BOOST_REQUIRE_EQUAL(lines.size(), 3);
@@ -359,7 +1464,7 @@ BOOST_AUTO_TEST_CASE(LogSourcesReceiveMessages)
 		logsource->Add(timer.Get(), Win32::GetSystemTimeAsFileTime(), 0, "processname", "TESTSTRING 1234\n");
 	}
 
-	auto morelines = logsources.GetLines();
+	auto morelines = GetLines(logsources, testsize);
 	BOOST_MESSAGE("received: " << morelines.size() << " lines.");
 	BOOST_REQUIRE_EQUAL(morelines.size(), testsize);
 }
@@ -373,7 +1478,7 @@ BOOST_AUTO_TEST_CASE(LogSourcesCharacterPreservation)
 	logsource->Add(timer.Get(), Win32::GetSystemTimeAsFileTime(), 0, "processname", "TrailingSpace ");
 	logsource->Add(timer.Get(), Win32::GetSystemTimeAsFileTime(), 0, "processname", "TrailingTab\t");
 
-	auto lines = logsources.GetLines();
+	auto lines = GetLines(logsources, 2);
 	BOOST_REQUIRE_EQUAL(lines.size(), 2);
 	BOOST_REQUIRE_EQUAL(lines[0].message, "TrailingSpace ");	// space preserved
 	BOOST_REQUIRE_EQUAL(lines[1].message, "TrailingTab\t");		// tab preserved
@@ -388,7 +1493,7 @@ BOOST_AUTO_TEST_CASE(LogSourcesTabHandling)
 	logsource->Add(timer.Get(), Win32::GetSystemTimeAsFileTime(), 0, "processname", "\tTabPrefix");
 	logsource->Add(timer.Get(), Win32::GetSystemTimeAsFileTime(), 0, "processname", "\t\tTwoTabsPrefixed");
 
-	auto lines = logsources.GetLines();
+	auto lines = GetLines(logsources, 2);
 	BOOST_REQUIRE_EQUAL(lines.size(), 2);
 	BOOST_REQUIRE_EQUAL(lines[0].message, "\tTabPrefix");	// space preserved
 	BOOST_REQUIRE_EQUAL(lines[1].message, "\t\tTwoTabsPrefixed");	// space preserved
@@ -404,13 +1509,35 @@ BOOST_AUTO_TEST_CASE(LogSourcesNewLineHandling)
 	logsource->Add(timer.Get(), Win32::GetSystemTimeAsFileTime(), 0, "processname", "NewLineCarriageReturnPostfix\n\r");
 	logsource->Add(timer.Get(), Win32::GetSystemTimeAsFileTime(), 0, "processname", "CarriageReturnNewLinePostfix\r\n");
 
-	auto lines = logsources.GetLines();
+	auto lines = GetLines(logsources, 3);
 	BOOST_REQUIRE_EQUAL(lines.size(), 3);
 	BOOST_REQUIRE_EQUAL(lines[0].message, "NewLinePostfix");
 	BOOST_REQUIRE_EQUAL(lines[1].message, "NewLineCarriageReturnPostfix");
 	BOOST_REQUIRE_EQUAL(lines[2].message, "CarriageReturnNewLinePostfix");
 }
 
+BOOST_AUTO_TEST_CASE(LogSourcesStageCounters)
+{
+	LogSources logsources(false);
+	BOOST_REQUIRE_EQUAL(logsources.GetLineBufferPolicy(), OverflowPolicy::DropNewest);
+	BOOST_REQUIRE_EQUAL(logsources.GetSourcePolicy(), OverflowPolicy::DropNewest);
+
+	// the normalize thread waits while 10 lines are not taken, the line buffer holds the rest
+	logsources.SetNormalizeLimit(10);
+	auto logsource = logsources.AddTestSource();
+	Timer timer;
+	for (int i = 0; i < 100; ++i)
+		logsource->Add(timer.Get(), Win32::GetSystemTimeAsFileTime(), 0, "processname", GetTestString(i));
+
+	auto lines = GetLines(logsources, 100);
+	BOOST_REQUIRE_EQUAL(lines.size(), 100u);
+	BOOST_REQUIRE_EQUAL(lines.back().message, GetTestString(99));
+	BOOST_REQUIRE_EQUAL(logsources.GetLineBufferCounters().added, 100u);
+	BOOST_REQUIRE_EQUAL(logsources.GetLineBufferCounters().dropped, 0u);
+	BOOST_REQUIRE_EQUAL(logsources.GetNormalizeCounters().added, 100u);
+	BOOST_REQUIRE_EQUAL(logsources.GetNormalizeCounters().dropped, 0u);
+}
+
 std::wstring GetExecutePath()
 {
 	using namespace boost;
@@ -435,7 +1562,7 @@ BOOST_AUTO_TEST_CASE(LogSourceDbwinReader)
 
 	Sleep(200);
 
-	auto lines = logsources.GetLines();
+	auto lines = GetLines(logsources, 1);
 	BOOST_REQUIRE_EQUAL(lines.size(), 1);
 }
 
@@ -98,6 +98,7 @@ void LogMessages(Settings settings)
 	});
 
 	std::string separator = settings.tabs ? "\t" : " ";
+	TimestampFormatter formatter;
 	while (!g_quit)
 	{
 		auto lines = sources.GetLines();
@@ -116,7 +117,7 @@ void LogMessages(Settings settings)
 			}
 			if (!settings.filename.empty())
 			{
-				WriteLogFileMessage(fs, it->time, it->systemTime, it->pid, it->processName, it->message);
+				WriteLogFileMessage(fs, formatter, it->time, it->systemTime, it->pid, it->processName, it->message);
 			}
 		}
 		if (settings.flush)
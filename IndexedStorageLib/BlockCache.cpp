@@ -0,0 +1,109 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#include "stdafx.h"
+#include "IndexedStorageLib/BlockCache.h"
+
+namespace fusion {
+namespace indexedstorage {
+
+BlockCache::BlockCache(size_t maxBytes) :
+	m_maxBytes(maxBytes),
+	m_bytes(0),
+	m_hits(0),
+	m_misses(0)
+{
+}
+
+void BlockCache::Clear()
+{
+	m_lru.clear();
+	m_index.clear();
+	m_bytes = 0;
+}
+
+BlockCache::BlockPtr BlockCache::Get(size_t blockIndex)
+{
+	// consecutive reads mostly hit the same block, avoid the hash lookup for that case
+	if (!m_lru.empty() && m_lru.front().first == blockIndex)
+	{
+		++m_hits;
+		return m_lru.front().second;
+	}
+
+	auto it = m_index.find(blockIndex);
+	if (it == m_index.end())
+	{
+		++m_misses;
+		return BlockPtr();
+	}
+
+	++m_hits;
+	m_lru.splice(m_lru.begin(), m_lru, it->second);
+	return it->second->second;
+}
+
+void BlockCache::Add(size_t blockIndex, BlockPtr block)
+{
+	auto it = m_index.find(blockIndex);
+	if (it != m_index.end())
+	{
+		m_bytes -= GetBlockBytes(*it->second->second);
+		m_lru.erase(it->second);
+		m_index.erase(it);
+	}
+
+	m_lru.push_front(Entry(blockIndex, block));
+	m_index[blockIndex] = m_lru.begin();
+	m_bytes += GetBlockBytes(*block);
+	Evict();
+}
+
+size_t BlockCache::GetMaxBytes() const
+{
+	return m_maxBytes;
+}
+
+void BlockCache::SetMaxBytes(size_t maxBytes)
+{
+	m_maxBytes = maxBytes;
+	Evict();
+}
+
+size_t BlockCache::GetBytes() const
+{
+	return m_bytes;
+}
+
+size_t BlockCache::GetHits() const
+{
+	return m_hits;
+}
+
+size_t BlockCache::GetMisses() const
+{
+	return m_misses;
+}
+
+size_t BlockCache::GetBlockBytes(const StringArena& block)
+{
+	return block.Size() + block.Count() * sizeof(size_t);
+}
+
+void BlockCache::Evict()
+{
+	while (m_bytes > m_maxBytes && m_lru.size() > 1)
+	{
+		auto& entry = m_lru.back();
+		m_bytes -= GetBlockBytes(*entry.second);
+		m_index.erase(entry.first);
+		m_lru.pop_back();
+	}
+}
+
+} // namespace indexedstorage
+} // namespace fusion
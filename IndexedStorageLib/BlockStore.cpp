@@ -0,0 +1,74 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#include "stdafx.h"
+#include "IndexedStorageLib/BlockStore.h"
+
+namespace fusion {
+namespace indexedstorage {
+
+SharedStringRef::SharedStringRef()
+{
+}
+
+SharedStringRef::SharedStringRef(boost::string_ref value, boost::shared_ptr<const void> block) :
+	m_value(value),
+	m_block(block)
+{
+}
+
+boost::string_ref SharedStringRef::str() const
+{
+	return m_value;
+}
+
+SharedStringRef::operator boost::string_ref() const
+{
+	return m_value;
+}
+
+BlockStore::~BlockStore()
+{
+}
+
+size_t MemoryBlockStore::BeginIndex() const
+{
+	return m_blocks.BeginIndex();
+}
+
+size_t MemoryBlockStore::EndIndex() const
+{
+	return m_blocks.EndIndex();
+}
+
+void MemoryBlockStore::PushBack(const char* data, size_t size)
+{
+	m_blocks.PushBack(std::string(data, size));
+}
+
+void MemoryBlockStore::PopFront()
+{
+	m_blocks.PopFront();
+}
+
+void MemoryBlockStore::Clear()
+{
+	m_blocks.Clear();
+}
+
+bool MemoryBlockStore::Get(size_t index, SharedStringRef& block) const
+{
+	auto data = m_blocks.Get(index);
+	if (!data)
+		return false;
+
+	block = SharedStringRef(*data, data);
+	return true;
+}
+
+} // namespace indexedstorage
+} // namespace fusion
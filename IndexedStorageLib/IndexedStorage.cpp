@@ -7,13 +7,16 @@
 
 #include "stdafx.h"
 #include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/make_shared.hpp>
+#include "CobaltFusion/make_unique.h"
 #include "IndexedStorageLib/IndexedStorage.h"
 #include "../libsnappy/libsnappy.h"
+#include "../Libraries/snappy/snappy-sinksource.h"
 
 namespace fusion {
 namespace indexedstorage {
-	
-const int blockSize = 400;
 
 bool VectorStorage::Empty() const
 {
@@ -42,54 +45,260 @@ std::string VectorStorage::operator[](size_t i) const
 	return m_storage[i];
 }
 
-SnappyStorage::SnappyStorage() :
-	m_readBlockIndex(-1),
-	m_writeBlockIndex(0)
+// TailBlock collects the strings of the block that is being written.
+// The text is written into fixed size chunks that are never reallocated,
+// so readers can access published lines while the writer appends.
+class SnappyStorage::TailBlock
+{
+public:
+	class Source;
+
+	explicit TailBlock(size_t blockIndex) :
+		m_blockIndex(blockIndex),
+		m_count(0)
+	{
+	}
+
+	void Reset(size_t blockIndex)
+	{
+		m_blockIndex = blockIndex;
+		m_count = 0;
+		if (m_chunks.size() > 1)
+			m_chunks.resize(1);
+		if (!m_chunks.empty())
+			m_chunks.front()->used = 0;
+	}
+
+	size_t BlockIndex() const
+	{
+		return m_blockIndex;
+	}
+
+	size_t Count() const
+	{
+		return m_count;
+	}
+
+	void Add(boost::string_ref value)
+	{
+		auto size = value.size() + 1;
+		if (m_chunks.empty() || m_chunks.back()->used + size > m_chunks.back()->data.size())
+			m_chunks.push_back(make_unique<Chunk>(std::max(size_t(chunkSize), size)));
+
+		auto& chunk = *m_chunks.back();
+		auto p = &chunk.data[chunk.used];
+		std::copy(value.begin(), value.end(), p);
+		p[value.size()] = '\0';
+		chunk.used += size;
+		m_lines[m_count] = boost::string_ref(p, value.size());
+		++m_count;
+	}
+
+	boost::string_ref operator[](size_t i) const
+	{
+		return m_lines[i];
+	}
+
+	size_t Size() const
+	{
+		size_t size = 0;
+		for (auto it = m_chunks.begin(); it != m_chunks.end(); ++it)
+			size += (*it)->used;
+		return size;
+	}
+
+private:
+	static const size_t chunkSize = 64*1024;
+
+	struct Chunk
+	{
+		explicit Chunk(size_t size) : data(size), used(0)
+		{
+		}
+
+		std::vector<char> data;
+		size_t used;
+	};
+
+	size_t m_blockIndex;
+	size_t m_count;
+	boost::string_ref m_lines[blockSize];
+	std::vector<std::unique_ptr<Chunk>> m_chunks;
+};
+
+// Source lets snappy compress the chunks of a TailBlock as one contiguous '\0' separated buffer
+class SnappyStorage::TailBlock::Source : public snappy::Source
+{
+public:
+	explicit Source(const TailBlock& block) :
+		m_chunks(block.m_chunks),
+		m_chunk(0),
+		m_offset(0),
+		m_available(block.Size())
+	{
+	}
+
+	virtual size_t Available() const
+	{
+		return m_available;
+	}
+
+	virtual const char* Peek(size_t* length)
+	{
+		while (m_chunk < m_chunks.size() && m_offset == m_chunks[m_chunk]->used)
+		{
+			++m_chunk;
+			m_offset = 0;
+		}
+
+		if (m_chunk == m_chunks.size())
+		{
+			*length = 0;
+			return nullptr;
+		}
+
+		*length = m_chunks[m_chunk]->used - m_offset;
+		return &m_chunks[m_chunk]->data[m_offset];
+	}
+
+	virtual void Skip(size_t n)
+	{
+		m_available -= n;
+		while (n > 0)
+		{
+			auto size = std::min(n, m_chunks[m_chunk]->used - m_offset);
+			m_offset += size;
+			n -= size;
+			if (m_offset == m_chunks[m_chunk]->used)
+			{
+				++m_chunk;
+				m_offset = 0;
+			}
+		}
+	}
+
+private:
+	const std::vector<std::unique_ptr<Chunk>>& m_chunks;
+	size_t m_chunk;
+	size_t m_offset;
+	size_t m_available;
+};
+
+SnappyStorage::SnappyStorage(size_t cacheSize) :
+	m_count(0),
+	m_tail(boost::make_shared<TailBlock>(0)),
+	m_storage(make_unique<MemoryBlockStore>()),
+	m_cache(cacheSize)
+{
+}
+
+SnappyStorage::SnappyStorage(std::unique_ptr<BlockStore> store, size_t cacheSize) :
+	m_count(0),
+	m_tail(boost::make_shared<TailBlock>(0)),
+	m_storage(std::move(store)),
+	m_cache(cacheSize)
 {
 }
 
 bool SnappyStorage::Empty() const
 {
-	return m_storage.empty();
+	return Count() == 0;
 }
 
 void SnappyStorage::Clear()
 {
-	m_storage.clear();
-	m_storage.shrink_to_fit();
+	m_storage->Clear();
+	m_tail->Reset(0);
+	m_count.store(0, boost::memory_order_release);
+
+	boost::mutex::scoped_lock lock(m_cacheMutex);
+	m_cache.Clear();
+}
 
-	m_readList.clear();
-	m_readList.shrink_to_fit();
-	m_readBlockIndex = -1;
+size_t SnappyStorage::Add(boost::string_ref value)
+{
+	auto index = m_count.load(boost::memory_order_relaxed);
+	m_tail->Add(value);
+	m_count.store(index + 1, boost::memory_order_release);
+
+	if (m_tail->Count() == blockSize)
+		Seal();
+	return index;
+}
 
-	m_writeList.clear();
-	m_writeList.shrink_to_fit();
-	m_writeBlockIndex = 0;
+void SnappyStorage::PopFront()
+{
+	m_storage->PopFront();
+}
+
+size_t SnappyStorage::BeginIndex() const
+{
+	return m_storage->BeginIndex() * blockSize;
 }
 
-size_t SnappyStorage::Add(const std::string& value)
+size_t SnappyStorage::EndIndex() const
 {
-	auto id = m_writeList.size();
-	m_writeList.push_back(value);
-	auto result = m_writeBlockIndex * blockSize + id;
-	if (id == blockSize - 1)
+	return m_count.load(boost::memory_order_acquire);
+}
+
+size_t SnappyStorage::Count() const
+{
+	// read the end first, so a concurrent PopFront() cannot make the count negative
+	auto end = EndIndex();
+	return end - BeginIndex();
+}
+
+std::string SnappyStorage::operator[](size_t i) const
+{
+	auto ref = GetStringRef(i);
+	auto value = ref.str();
+	return std::string(value.begin(), value.end());
+}
+
+SharedStringRef SnappyStorage::GetStringRef(size_t index) const
+{
+	if (index >= EndIndex() || index < BeginIndex())
+		throw std::out_of_range("SnappyStorage index out of range");
+
+	auto blockId = GetBlockIndex(index);
+	auto id = GetRelativeIndex(index);
+	for (;;)
 	{
-		std::string test = Compress(m_writeList);
-		m_storage.push_back(test);
-		m_writeList.clear();
-		++m_writeBlockIndex;
+		if (blockId < m_storage->EndIndex())
+		{
+			auto block = GetBlock(blockId);
+			return SharedStringRef((*block)[id], block);
+		}
+
+		// the tail can be sealed after the check above, then the line is found in the sealed block
+		auto tail = boost::atomic_load(&m_tail);
+		if (tail->BlockIndex() == blockId)
+			return SharedStringRef((*tail)[id], tail);
 	}
-	return result;
 }
 
-size_t SnappyStorage::Count() const
+size_t SnappyStorage::GetCacheSize() const
 {
-	return m_storage.size();
+	boost::mutex::scoped_lock lock(m_cacheMutex);
+	return m_cache.GetMaxBytes();
+}
+
+void SnappyStorage::SetCacheSize(size_t bytes)
+{
+	boost::mutex::scoped_lock lock(m_cacheMutex);
+	m_cache.SetMaxBytes(bytes);
+}
+
+size_t SnappyStorage::GetCacheHits() const
+{
+	boost::mutex::scoped_lock lock(m_cacheMutex);
+	return m_cache.GetHits();
 }
 
-std::string SnappyStorage::operator[](size_t i)
+size_t SnappyStorage::GetCacheMisses() const
 {
-	return GetString(i);
+	boost::mutex::scoped_lock lock(m_cacheMutex);
+	return m_cache.GetMisses();
 }
 
 size_t SnappyStorage::GetBlockIndex(size_t index) const
@@ -102,55 +311,56 @@ size_t SnappyStorage::GetRelativeIndex(size_t index) const
 	return index % blockSize;
 }
 
-std::string SnappyStorage::GetString(size_t index)
+void SnappyStorage::Seal()
 {
-	auto blockId = GetBlockIndex(index);
-	auto id = GetRelativeIndex(index);
-		
-	if (blockId == m_writeBlockIndex)
-	{
-		return m_writeList[id];
-	}
+	Compress(*m_tail);
 
-	if (blockId != m_readBlockIndex)
-	{
-		m_readList = Decompress(m_storage[blockId]);
-		m_readBlockIndex = blockId;
-	}
-	return m_readList[id];
+	// the sealed tail block stays alive as long as readers hold on to it
+	boost::atomic_store(&m_tail, boost::make_shared<TailBlock>(m_storage->EndIndex()));
 }
 
-std::string SnappyStorage::Compress(const std::vector<std::string>& value) const
+void SnappyStorage::Compress(TailBlock& block)
+{
+	TailBlock::Source source(block);
+	m_compressBuffer.resize(snappy::MaxCompressedLength(source.Available()));
+	snappy::UncheckedByteArraySink sink(&m_compressBuffer[0]);
+	auto length = snappy::Compress(&source, &sink);
+	m_storage->PushBack(&m_compressBuffer[0], length);
+}
+
+BlockCache::BlockPtr SnappyStorage::GetBlock(size_t blockIndex) const
 {
-	std::vector<char> raw;
-	for (auto s = value.begin(); s != value.end(); ++s)
 	{
-		for (auto t = s->begin(); t != s->end(); ++t)
-		{
-			raw.push_back(*t);
-		}
-		raw.push_back('\0');
+		boost::mutex::scoped_lock lock(m_cacheMutex);
+		auto block = m_cache.Get(blockIndex);
+		if (block)
+			return block;
 	}
-	std::string data;
-	snappy::Compress(&raw[0], raw.size(), &data);
-	return data;
+
+	// the block can be dropped by PopFront() after the caller checked the index
+	SharedStringRef compressed;
+	if (!m_storage->Get(blockIndex, compressed))
+		throw std::out_of_range("SnappyStorage index out of range");
+
+	// decompress outside the lock, so readers of other blocks are not held up
+	auto block = Decompress(compressed);
+	boost::mutex::scoped_lock lock(m_cacheMutex);
+	m_cache.Add(blockIndex, block);
+	return block;
 }
 
-std::vector<std::string> SnappyStorage::Decompress(const std::string& value) const
+BlockCache::BlockPtr SnappyStorage::Decompress(boost::string_ref block) const
 {
-	std::vector<std::string> vec;
+	auto arena = boost::make_shared<StringArena>();
+	size_t length = 0;
+	if (!snappy::GetUncompressedLength(block.data(), block.size(), &length))
+		throw std::runtime_error("corrupt storage block");
 
-	std::string data;
-	snappy::Uncompress(value.c_str(), value.size(), &data);
-
-	for (auto it = data.begin(); it != data.end(); ++it)
-	{
-		auto begin = it;
-		while (*it)
-			++it;
-		vec.push_back(std::string(begin, it));
-	}
-	return vec;
+	auto data = arena->Reset(length);
+	if (!snappy::RawUncompress(block.data(), block.size(), data))
+		throw std::runtime_error("corrupt storage block");
+	arena->BuildIndex();
+	return arena;
 }
 
 } // namespace indexedstorage 
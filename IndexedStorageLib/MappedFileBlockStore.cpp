@@ -0,0 +1,225 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#include "stdafx.h"
+#include <algorithm>
+#include <cstring>
+#include <array>
+#include <boost/make_shared.hpp>
+#include "CobaltFusion/make_unique.h"
+#include "Win32/Win32Lib.h"
+#include "IndexedStorageLib/MappedFileBlockStore.h"
+
+namespace fusion {
+namespace indexedstorage {
+
+// Segment is a temporary file of a fixed size with a mapping object, views are mapped by the users
+class MappedFileBlockStore::Segment : boost::noncopyable
+{
+public:
+	Segment(const std::wstring& directory, size_t size) :
+		m_size(size)
+	{
+		std::array<wchar_t, MAX_PATH> path;
+		if (::GetTempFileNameW(directory.c_str(), L"dbv", 0, path.data()) == 0)
+			Win32::ThrowLastError(L"GetTempFileName");
+
+		HANDLE hFile = ::CreateFileW(path.data(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+		if (hFile == INVALID_HANDLE_VALUE)
+			Win32::ThrowLastError(path.data());
+		m_file.reset(hFile);
+
+		auto size64 = static_cast<unsigned long long>(size);
+		m_mapping = Win32::CreateFileMapping(m_file.get(), nullptr, PAGE_READWRITE, static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64), nullptr);
+	}
+
+	size_t Size() const
+	{
+		return m_size;
+	}
+
+	HANDLE Mapping() const
+	{
+		return m_mapping.get();
+	}
+
+private:
+	size_t m_size;
+	Win32::Handle m_file;
+	Win32::Handle m_mapping;
+};
+
+// View maps [offset, offset + size) of a segment for reading, it keeps the segment alive
+class MappedFileBlockStore::View : boost::noncopyable
+{
+public:
+	View(const boost::shared_ptr<Segment>& segment, size_t offset, size_t size) :
+		m_segment(segment),
+		m_offset(offset),
+		m_size(size),
+		m_view(segment->Mapping(), FILE_MAP_READ, static_cast<DWORD>(static_cast<unsigned long long>(offset) >> 32), static_cast<DWORD>(offset), size)
+	{
+	}
+
+	bool Contains(const Segment& segment, size_t offset, size_t size) const
+	{
+		return &segment == m_segment.get() && offset >= m_offset && offset + size <= m_offset + m_size;
+	}
+
+	const char* Data(size_t offset) const
+	{
+		return static_cast<const char*>(m_view.Ptr()) + (offset - m_offset);
+	}
+
+private:
+	boost::shared_ptr<Segment> m_segment;
+	size_t m_offset;
+	size_t m_size;
+	Win32::MappedViewOfFile m_view;
+};
+
+MappedFileBlockStore::Location::Location(const boost::shared_ptr<Segment>& segment, size_t offset, size_t size) :
+	segment(segment),
+	offset(offset),
+	size(size)
+{
+}
+
+MappedFileBlockStore::Location::Location(const char* data, size_t size) :
+	offset(0),
+	size(size),
+	data(data, size)
+{
+}
+
+MappedFileBlockStore::MappedFileBlockStore(const std::wstring& directory, size_t segmentSize) :
+	m_directory(directory.empty() ? Win32::GetTempPath() : directory),
+	m_segmentSize(segmentSize),
+	m_inMemory(false),
+	m_writeOffset(0)
+{
+}
+
+MappedFileBlockStore::~MappedFileBlockStore()
+{
+}
+
+size_t MappedFileBlockStore::BeginIndex() const
+{
+	return m_blocks.BeginIndex();
+}
+
+size_t MappedFileBlockStore::EndIndex() const
+{
+	return m_blocks.EndIndex();
+}
+
+void MappedFileBlockStore::PushBack(const char* data, size_t size)
+{
+	if (!m_inMemory && (!m_segment || m_writeOffset + size > m_segment->Size()))
+		AddSegment(size);
+
+	if (m_inMemory)
+	{
+		m_blocks.PushBack(Location(data, size));
+		return;
+	}
+
+	std::memcpy(static_cast<char*>(m_writeView->Ptr()) + m_writeOffset, data, size);
+	m_blocks.PushBack(Location(m_segment, m_writeOffset, size));
+	m_writeOffset += size;
+}
+
+// the full segment is unmapped, only the blocks that are read are mapped again through the view cache
+void MappedFileBlockStore::AddSegment(size_t size)
+{
+	m_writeView.reset();
+	m_segment.reset();
+	m_writeOffset = 0;
+
+	try
+	{
+		auto segment = boost::make_shared<Segment>(m_directory, std::max(m_segmentSize, size));
+		m_writeView = make_unique<Win32::MappedViewOfFile>(segment->Mapping(), FILE_MAP_WRITE, 0, 0, segment->Size());
+		m_segment = segment;
+	}
+	catch (std::exception&)
+	{
+		// the disk is full or the address space is exhausted, losing lines is worse than using memory
+		m_inMemory = true;
+	}
+}
+
+void MappedFileBlockStore::PopFront()
+{
+	m_blocks.PopFront();
+}
+
+void MappedFileBlockStore::Clear()
+{
+	m_blocks.Clear();
+	m_writeView.reset();
+	m_segment.reset();
+	m_writeOffset = 0;
+	m_inMemory = false;
+
+	boost::mutex::scoped_lock lock(m_viewMutex);
+	m_views.clear();
+}
+
+bool MappedFileBlockStore::Get(size_t index, SharedStringRef& block) const
+{
+	auto location = m_blocks.Get(index);
+	if (!location)
+		return false;
+
+	if (!location->segment)
+	{
+		block = SharedStringRef(location->data, location);
+		return true;
+	}
+
+	auto view = GetView(location->segment, location->offset, location->size);
+	block = SharedStringRef(boost::string_ref(view->Data(location->offset), location->size), view);
+	return true;
+}
+
+boost::shared_ptr<const MappedFileBlockStore::View> MappedFileBlockStore::GetView(const boost::shared_ptr<Segment>& segment, size_t offset, size_t size) const
+{
+	boost::mutex::scoped_lock lock(m_viewMutex);
+	for (auto it = m_views.begin(); it != m_views.end(); ++it)
+	{
+		if ((*it)->Contains(*segment, offset, size))
+		{
+			m_views.splice(m_views.begin(), m_views, it);
+			return m_views.front();
+		}
+	}
+
+	// views start at a multiple of viewSize, a block that crosses the boundary extends its view
+	size_t begin = offset / viewSize * viewSize;
+	size_t end = std::min(segment->Size(), std::max(begin + viewSize, offset + size));
+	boost::shared_ptr<const View> view;
+	try
+	{
+		view = boost::make_shared<View>(segment, begin, end - begin);
+	}
+	catch (Win32::Win32Error&)
+	{
+		// release the cached views to make room in the address space
+		m_views.clear();
+		view = boost::make_shared<View>(segment, begin, end - begin);
+	}
+
+	m_views.push_front(view);
+	if (m_views.size() > viewCacheSize)
+		m_views.pop_back();
+	return view;
+}
+
+} // namespace indexedstorage
+} // namespace fusion
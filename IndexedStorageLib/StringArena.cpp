@@ -0,0 +1,84 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#include "stdafx.h"
+#include <cstring>
+#include "IndexedStorageLib/StringArena.h"
+
+namespace fusion {
+namespace indexedstorage {
+
+bool StringArena::Empty() const
+{
+	return m_offsets.empty();
+}
+
+void StringArena::Clear()
+{
+	m_data.clear();
+	m_offsets.clear();
+}
+
+size_t StringArena::Add(boost::string_ref value)
+{
+	auto offset = m_data.size();
+	m_offsets.push_back(offset);
+	m_data.resize(offset + value.size() + 1);
+	if (!value.empty())
+		std::memcpy(&m_data[offset], value.data(), value.size());
+	m_data[offset + value.size()] = '\0';
+	return m_offsets.size() - 1;
+}
+
+size_t StringArena::Count() const
+{
+	return m_offsets.size();
+}
+
+boost::string_ref StringArena::operator[](size_t i) const
+{
+	auto begin = m_offsets[i];
+	auto end = i + 1 < m_offsets.size() ? m_offsets[i + 1] : m_data.size();
+	return boost::string_ref(&m_data[begin], end - begin - 1);
+}
+
+const char* StringArena::Data() const
+{
+	return m_data.empty() ? nullptr : &m_data[0];
+}
+
+size_t StringArena::Size() const
+{
+	return m_data.size();
+}
+
+char* StringArena::Reset(size_t size)
+{
+	m_offsets.clear();
+	m_data.resize(size);
+	return m_data.empty() ? nullptr : &m_data[0];
+}
+
+void StringArena::BuildIndex()
+{
+	m_offsets.clear();
+	if (m_data.empty())
+		return;
+
+	const char* begin = &m_data[0];
+	const char* end = begin + m_data.size();
+	for (auto p = begin; p != end; ++p)
+	{
+		m_offsets.push_back(p - begin);
+		p = static_cast<const char*>(std::memchr(p, '\0', end - p));
+		if (p == nullptr)
+			break;
+	}
+}
+
+} // namespace indexedstorage
+} // namespace fusion
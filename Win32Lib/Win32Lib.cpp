@@ -460,6 +460,15 @@ std::wstring GetDlgItemText(HWND hDlg, int idc)
 	return GetWindowText(hWnd);
 }
 
+std::wstring GetTempPath()
+{
+	std::vector<wchar_t> path(MAX_PATH + 1);
+	DWORD length = ::GetTempPathW(static_cast<DWORD>(path.size()), path.data());
+	if (length == 0)
+		ThrowLastError("GetTempPath");
+	return std::wstring(path.data(), length);
+}
+
 bool IsGUIThread()
 {
 	return ::IsGUIThread(FALSE) == TRUE;
@@ -0,0 +1,109 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2015.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <new>
+#include <cassert>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace fusion {
+
+// AppendVector is an append-only vector for one writer thread and any number of reader threads.
+// Elements are stored in segments that double in size and are never moved, the writer publishes
+// a new element by a release-store of the size, so readers need no locks to access elements [0, Size()).
+// Segment k holds BaseSize * 2^k elements, a BaseSize that is a multiple of N keeps each run of N
+// elements that starts at a multiple of N inside one segment.
+template <typename T, size_t BaseSize = 1024>
+class AppendVector : boost::noncopyable
+{
+public:
+	AppendVector() :
+		m_size(0)
+	{
+		for (size_t i = 0; i < maxSegments; ++i)
+			m_segments[i] = nullptr;
+	}
+
+	~AppendVector()
+	{
+		Clear();
+		for (size_t i = 0; i < maxSegments; ++i)
+			::operator delete(m_segments[i]);
+	}
+
+	bool Empty() const
+	{
+		return Size() == 0;
+	}
+
+	size_t Size() const
+	{
+		return m_size.load(boost::memory_order_acquire);
+	}
+
+	const T& operator[](size_t i) const
+	{
+		size_t offset;
+		auto segment = GetSegment(i, offset);
+		return m_segments[segment][offset];
+	}
+
+	// writer only
+	T& operator[](size_t i)
+	{
+		size_t offset;
+		auto segment = GetSegment(i, offset);
+		return m_segments[segment][offset];
+	}
+
+	// writer only
+	void PushBack(const T& value)
+	{
+		auto size = m_size.load(boost::memory_order_relaxed);
+		size_t offset;
+		auto segment = GetSegment(size, offset);
+		if (m_segments[segment] == nullptr)
+			m_segments[segment] = static_cast<T*>(::operator new(GetSegmentSize(segment) * sizeof(T)));
+		new (m_segments[segment] + offset) T(value);
+		m_size.store(size + 1, boost::memory_order_release);
+	}
+
+	// writer only, must not be called while there are readers
+	void Clear()
+	{
+		auto size = m_size.load(boost::memory_order_relaxed);
+		for (size_t i = 0; i < size; ++i)
+			(*this)[i].~T();
+		m_size.store(0, boost::memory_order_release);
+	}
+
+private:
+	static const size_t maxSegments = 40;
+
+	static size_t GetSegmentSize(size_t segment)
+	{
+		return BaseSize << segment;
+	}
+
+	static size_t GetSegment(size_t i, size_t& offset)
+	{
+		size_t n = i / BaseSize + 1;
+		size_t segment = 0;
+		while (n >>= 1)
+			++segment;
+		assert(segment < maxSegments);
+		offset = i - BaseSize * ((size_t(1) << segment) - 1);
+		return segment;
+	}
+
+	T* m_segments[maxSegments];
+	boost::atomic<size_t> m_size;
+};
+
+} // namespace fusion
@@ -27,12 +27,19 @@ public:
 	size_t Available() const;
 	size_t Size() const;
 	
-	// Performance can be improved by doing block-operations, for example using a Duff-device
 	char Read();
 	std::string ReadStringZ();
 	void Write(char c);
 	void WriteStringZ(const char* message);
 
+	// block operations, the data is copied with at most two memcpy's around the end of the buffer.
+	// Read() requires Size() >= size, Write() requires Available() >= size
+	void Read(void* data, size_t size);
+	void Write(const void* data, size_t size);
+
+	// discards 'size' bytes, requires Size() >= size
+	void Skip(size_t size);
+
 	void Clear();
 	void Swap(CircularBuffer& circularBuffer);
 	void DumpStats();
@@ -0,0 +1,91 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <memory>
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+#include "LineBuffer.h"
+#include "OverflowPolicy.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+// CircularLineBuffer queues lines as variable-length records in a fixed size ring of 'size' bytes, rounded up to a power of two:
+// a fixed header followed by the process name and message bytes, written and read with memcpy.
+// Any number of producers may Add(), a single consumer calls GetLines(). A producer reserves the space of its record with
+// one compare-and-swap on the write position, copies the record outside of any lock and publishes it by storing its size
+// in the commit slot of its first unit. The consumer takes the committed records in order and releases their space.
+// The producers only take a mutex when the ring is full, to wait, to drop the oldest lines or to count a dropped line.
+// With OverflowPolicy::DropNewest all lines are dropped from the first line that does not fit until the next
+// GetLines(), which ends its batch with the "N lines dropped" line.
+// The consumer owns the process handles of the lines it takes, the handle of a dropped line is closed here.
+class CircularLineBuffer : public ILineBuffer
+{
+public:
+	CircularLineBuffer(size_t size, OverflowPolicy::type policy);
+
+	virtual void Add(double time, FILETIME systemTime, HANDLE handle, const std::string& message, const LogSource* pSource);
+	virtual void Add(double time, FILETIME systemTime, DWORD pid, const std::string& processName, const std::string& message, const LogSource* pSource);
+	virtual Lines GetLines();
+	virtual bool Empty() const;
+
+	OverflowPolicy::type GetPolicy() const;
+	void SetPolicy(OverflowPolicy::type policy);
+	StageCounters GetCounters() const;
+
+	// stops blocked producers, from now on lines that do not fit are dropped
+	void Abort();
+
+private:
+	static const size_t unitSize = 16;	// records start at a multiple of unitSize, each unit has a commit slot
+
+	struct Header
+	{
+		double time;
+		FILETIME systemTime;
+		HANDLE handle;
+		DWORD pid;
+		const LogSource* pLogSource;
+		size_t processNameSize;
+		size_t messageSize;
+	};
+
+	void Write(double time, FILETIME systemTime, HANDLE handle, DWORD pid, const std::string& processName, const std::string& message, const LogSource* pSource);
+	bool TryReserve(size_t size, size_t& position);
+	bool Overflow(const Header& header, size_t size, size_t& position);
+	bool DropOldest();
+	boost::atomic<size_t>& Committed(size_t position) const;
+	void CopyIn(size_t position, const void* data, size_t size);
+	void CopyOut(size_t position, void* data, size_t size) const;
+	void ReadString(size_t position, std::string& s, size_t size) const;
+
+	size_t m_capacity;
+	std::unique_ptr<char[]> m_ring;
+	std::unique_ptr<boost::atomic<size_t>[]> m_committed;	// the size of the record that starts at a unit, 0 while it is not written yet
+	size_t m_maxTextSize;
+	boost::atomic<size_t> m_reserved;	// positions increase monotonically, the ring offset is position & (m_capacity - 1)
+	boost::atomic<size_t> m_read;
+	boost::atomic<size_t> m_count;
+	boost::atomic<size_t> m_added;
+	boost::atomic<size_t> m_peak;
+	boost::atomic<size_t> m_waiting;	// producers in Overflow(), the consumer only notifies m_cond when there are any
+	boost::atomic<bool> m_dropping;		// m_droppedLines > 0
+	boost::mutex m_readMutex;			// held by the consumer and by a producer that drops the oldest lines
+
+	mutable boost::mutex m_mutex;
+	boost::condition_variable m_cond;
+	OverflowPolicy::type m_policy;
+	bool m_abort;
+	StageCounters m_counters;	// dropped and blocked, the others are atomic
+	size_t m_droppedLines;		// OverflowPolicy::DropNewest lines since the last GetLines()
+	Header m_lastDropped;
+};
+
+} // namespace debugviewpp
+} // namespace fusion
@@ -26,5 +26,8 @@ COLORREF GetRandomBackColor();
 COLORREF GetRandomTextColor();
 COLORREF GetRandomProcessColor();
 
+// the color of the index-th token of an auto colored filter, the same index always gives the same color
+COLORREF GetTokenBackColor(size_t index);
+
 } // namespace debugviewpp 
 } // namespace fusion
@@ -9,7 +9,9 @@
 
 #include <windows.h>
 #include <string>
+#include <cstdint>
 #include "Win32/Win32Lib.h"
+#include "DebugView++Lib/TimeParser.h"
 
 namespace fusion {
 namespace debugviewpp {
@@ -21,6 +23,38 @@ std::string GetDateTimeText(const FILETIME& filetime);
 std::string GetTimeText(const SYSTEMTIME& st);
 std::string GetTimeText(const FILETIME& ft);
 
+// TimestampFormatter writes fixed-width local time text into caller buffers, without a terminating '\0'.
+// The text up to the milliseconds is cached for the last second that was formatted, so consecutive lines
+// in the same second only format their milliseconds, and the Win32 time conversions run once per second.
+// A TimestampFormatter is not thread safe, use one per thread.
+class TimestampFormatter
+{
+public:
+	static const size_t dateTimeSize = 23;	// "yyyy/MM/dd HH:mm:ss.mmm"
+	static const size_t timeSize = 12;		// "HH:mm:ss.mmm"
+	static const size_t offsetSize = 32;	// "%.06f"
+
+	TimestampFormatter();
+
+	// each returns the number of characters written
+	size_t FormatDateTime(const FILETIME& ft, char* buffer);
+	size_t FormatTime(const FILETIME& ft, char* buffer);
+	static size_t FormatOffset(double time, char* buffer);
+
+	// the locale dependent date text, cached per day
+	const std::string& FormatDate(const FILETIME& ft);
+
+private:
+	unsigned Update(const FILETIME& ft);
+
+	uint64_t m_second;
+	uint64_t m_day;
+	uint64_t m_dateDay;
+	char m_text[dateTimeSize - 2];	// "yyyy/MM/dd HH:mm:ss." and '\0'
+	SYSTEMTIME m_st;
+	std::string m_date;
+};
+
 template <typename CharT>
 std::basic_string<CharT> TabsToSpaces(const std::basic_string<CharT>& s, int tabsize = 4)
 {
@@ -65,6 +99,9 @@ int ExpandedTabOffset(const std::basic_string<CharT>& s, int offset, int tabsize
 	return pos;
 }
 
+// USTimeConverter assumes the next day when a time is before the previous time, so times must be converted in order.
+// ParseTimeOfDay() has no state, so lines can be parsed in parallel as long as the results are passed to Convert() in line order.
+// The local time zone bias is taken once at construction, Convert() itself is plain integer arithmetic.
 class USTimeConverter
 {
 public:
@@ -73,10 +110,11 @@ public:
 	bool ReadLocalTimeUSRegion(const std::string& text, FILETIME& ft);
 	bool ReadLocalTimeUSRegionMs(const std::string& text, FILETIME& ft);
 
+	FILETIME Convert(const USTime& time);
+
 private:
-	FILETIME USTimeToFiletime(WORD h, WORD m, WORD s, WORD ms);
-	FILETIME m_lastFileTime;
-	bool m_firstValue;
+	uint64_t m_lastTime;
+	int64_t m_utcBias;
 };
 
 } // namespace debugviewpp 
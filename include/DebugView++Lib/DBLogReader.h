@@ -15,6 +15,9 @@ namespace debugviewpp {
 
 class ILineBuffer;
 
+// seconds from ft1 to ft2
+double GetDifference(FILETIME ft1, FILETIME ft2);
+
 class DBLogReader : public FileReader
 {
 public:
@@ -27,6 +30,7 @@ private:
 	long m_linenumber;
 	FILETIME m_firstFiletime;
 	USTimeConverter m_converter;
+	TimeFormat::type m_timeFormat;
 };
 
 } // namespace debugviewpp 
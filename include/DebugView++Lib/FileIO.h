@@ -8,12 +8,16 @@
 #pragma once
 
 #include <iosfwd>
+#include <vector>
+#include <boost/utility/string_ref.hpp>
 #include "DebugView++Lib/Line.h"
+#include "DebugView++Lib/TimeParser.h"
 
 namespace fusion {
 namespace debugviewpp {
 
 class USTimeConverter;
+class TimestampFormatter;
 
 const std::string g_debugViewPPIdentification1 = "File Identification Header, DebugView++ Format Version 1";
 const std::string g_debugViewPPIdentification2 = "File Identification Header, DebugView++ Format Version 2";	// not yet used
@@ -42,8 +46,16 @@ bool IsBinaryFileType(FileType::type);
 
 std::istream& ReadLogFileMessage(std::istream& is, Line& line);
 
-bool ReadSysInternalsLogFileMessage(const std::string& data, Line& line, USTimeConverter& converter);
-bool ReadLogFileMessage(const std::string& data, Line& line);
+bool ReadSysInternalsLogFileMessage(boost::string_ref data, Line& line, USTimeConverter& converter);
+
+// 'format' is the time format of the file, start with TimeFormat::Unknown and pass the same
+// variable for all lines of a file, so the format is only detected once.
+bool ReadSysInternalsLogFileMessage(boost::string_ref data, Line& line, USTimeConverter& converter, TimeFormat::type& format);
+
+// Parse a Sysinternals line without converting the time of day, returns true when line.systemTime
+// must still be set by USTimeConverter::Convert(time), in line order, see USTimeConverter.
+bool ParseSysInternalsLogFileMessage(boost::string_ref data, Line& line, USTime& time, TimeFormat::type& format);
+bool ReadLogFileMessage(boost::string_ref data, Line& line);
 
 std::ostream& operator<<(std::ostream& os, const FILETIME& ft);
 
@@ -53,7 +65,13 @@ struct OpenMode
 };
 
 void OpenLogFile(std::ofstream& ofstream, const std::wstring& filename, OpenMode::type mode = OpenMode::Truncate );
-void WriteLogFileMessage(std::ofstream& ofstream, double time, FILETIME filetime, DWORD pid, const std::string& processName, std::string message);
+void WriteLogFileMessage(std::ofstream& ofstream, double time, FILETIME filetime, DWORD pid, const std::string& processName, const std::string& message);
+
+// use one formatter for all lines that are written, so the timestamp text is only formatted once per second
+void WriteLogFileMessage(std::ofstream& ofstream, TimestampFormatter& formatter, double time, FILETIME filetime, DWORD pid, const std::string& processName, const std::string& message);
+
+// append the same text as WriteLogFileMessage() to 'buffer', no allocation takes place when 'buffer' has enough capacity
+void AppendLogFileMessage(std::vector<char>& buffer, TimestampFormatter& formatter, double time, FILETIME filetime, DWORD pid, const std::string& processName, const std::string& message);
 
 } // namespace debugviewpp 
 } // namespace fusion
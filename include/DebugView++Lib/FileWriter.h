@@ -8,8 +8,12 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <fstream>
 #include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include "DebugView++Lib/Conversions.h"
 
 namespace fusion {
 namespace debugviewpp {
@@ -18,16 +22,54 @@ std::ostream& operator<<(std::ostream& os, const FILETIME& ft);
 
 class LogFile;
 
-class FileWriter
+// when FileWriter writes its buffer to the file, in any case the buffer is written when it is full and when the writer is destroyed
+struct FlushPolicy
+{
+	enum type
+	{
+		EveryBatch,		// after each batch of lines
+		Interval,		// at most 'value' milliseconds after the first unwritten line
+		Size			// when 'value' bytes are buffered
+	};
+
+	explicit FlushPolicy(type policy = Interval, size_t value = 100) :
+		policy(policy),
+		value(value)
+	{
+	}
+
+	type policy;
+	size_t value;
+};
+
+// FileWriter appends the lines of a LogFile to a .dblog file on its own thread.
+// The thread sleeps until Notify() reports new lines, it then formats all lines that were added since
+// into one preallocated buffer, that is written to the file in one call as the FlushPolicy demands.
+class FileWriter : boost::noncopyable
 {
 public:
-	FileWriter(const std::wstring& filename, LogFile& logfile);
+	FileWriter(const std::wstring& filename, LogFile& logfile, const FlushPolicy& flushPolicy = FlushPolicy());
+	~FileWriter();
+
+	// called by the thread that adds lines to the LogFile, after adding one or more lines
+	void Notify();
 
 private:
+	static const size_t bufferSize = 1024 * 1024;
+
 	void Run();
-	
+	void WriteLines(size_t& writeIndex);
+	void Flush();
+
+	FlushPolicy m_flushPolicy;
 	std::ofstream m_ofstream;
 	LogFile& m_logfile;
+	TimestampFormatter m_formatter;
+	std::vector<char> m_buffer;
+	boost::atomic<bool> m_pending;
+	bool m_stop;
+	boost::mutex m_mutex;
+	boost::condition_variable m_cond;
 	boost::thread m_thread;
 };
 
@@ -11,8 +11,10 @@
 #include <regex>
 #include <vector>
 #include <unordered_map>
+#include <boost/shared_ptr.hpp>
 #include "MatchType.h"
 #include "FilterType.h"
+#include "LiteralMatcher.h"
 
 #pragma comment(lib, "DebugView++Lib.lib")
 
@@ -21,13 +23,27 @@ namespace debugviewpp {
 
 typedef std::unordered_map<std::string, COLORREF> MatchColors;
 
+// the compiled form of a filter text. Patterns are immutable and shared by all filters with the same text and MatchType,
+// so copying a Filter or a LogFilter does not compile or copy a std::regex.
+struct FilterPattern
+{
+	FilterPattern(const std::string& text, MatchType::type matchType);
+
+	std::regex re;
+	LiteralMatcher literal;
+};
+
+// the pattern of (text, matchType) from a process wide cache, that keeps a pattern as long as a filter uses it.
+// can be called from any thread, throws std::regex_error for an invalid regular expression.
+boost::shared_ptr<const FilterPattern> GetFilterPattern(const std::string& text, MatchType::type matchType);
+
 struct Filter
 {
 	Filter();
 	Filter(const std::string& text, MatchType::type matchType, FilterType::type filterType, COLORREF bgColor = RGB(255, 255, 255), COLORREF fgColor = RGB(0, 0, 0), bool enable = true, bool matched = false);
 
 	std::string text;
-	std::regex re;
+	boost::shared_ptr<const FilterPattern> pattern;
 	MatchType::type matchType;
 	FilterType::type filterType;
 	COLORREF bgColor;
@@ -45,6 +61,16 @@ struct LogFilter
 void SaveFilterSettings(const std::vector<Filter>& filters, CRegKey& reg);
 void LoadFilterSettings(std::vector<Filter>& filters, CRegKey& reg);
 
+// Simple and Wildcard filters are matched by their LiteralMatcher, std::regex is only used for regular expressions
+bool IsMatch(const Filter& filter, const std::string& text);
+
+// appends the MatchColors keys of the tokens in 'text' that 'filter' matches
+void GetMatchKeys(const Filter& filter, const std::string& text, std::vector<std::string>& keys);
+
+// assign a color to each token matched by an Auto colored filter that has no color yet, see GetTokenBackColor()
+void AddMatchColors(const Filter& filter, const std::string& text, MatchColors& matchColors);
+void AddMatchColors(const std::vector<std::string>& keys, MatchColors& matchColors);
+
 bool IsIncluded(std::vector<Filter>& filters, const std::string& message, MatchColors& matchColors);
 bool MatchFilterType(const std::vector<Filter>& filters, FilterType::type type, const std::string& text);
 
@@ -0,0 +1,165 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <boost/utility/string_ref.hpp>
+#include <boost/dynamic_bitset.hpp>
+#include "DebugView++Lib/Filter.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+// MultiLiteralMatcher is an Aho-Corasick automaton that finds which of a set of literals occur in a text
+// in one pass over the text. ASCII letters compare case insensitive, like the std::regex::icase filters do.
+// The goto and failure functions are compiled into one transition table over the characters that occur in the literals.
+class MultiLiteralMatcher
+{
+public:
+	MultiLiteralMatcher();
+
+	// 'id' is the index that Find() marks in 'found' when 'literal' occurs, empty literals are ignored
+	void Add(const std::string& literal, size_t id);
+	void Compile();
+	bool Empty() const;
+
+	// sets found[id] to 1 for each literal that occurs in 'text', other elements are left unchanged
+	void Find(boost::string_ref text, std::vector<unsigned char>& found) const;
+
+private:
+	std::vector<std::pair<std::string, size_t>> m_literals;
+	unsigned char m_class[256];
+	size_t m_classes;
+	std::vector<int> m_next;
+	std::vector<size_t> m_outputBegin;
+	std::vector<size_t> m_outputs;
+};
+
+// lower case literal that must occur in any text that matches 'text' as a 'matchType' filter, empty when there is none.
+// 'exact' is set when occurrence of the literal is the whole match condition.
+std::string RequiredLiteral(const std::string& text, MatchType::type matchType, bool& exact);
+
+// FilterMatch holds which filters of a FilterEngine matched one text
+struct FilterMatch
+{
+	FilterMatch();
+
+	bool Matched(FilterType::type type) const;
+
+	std::vector<unsigned char> filters;
+	unsigned types;
+};
+
+// FilterCache keeps the result of FilterEngine::Match() per id, for texts that are the same for all lines with that id,
+// like the process name of a process uid. Each filter has a bitmap over the ids, so a cached match is one bit test per filter.
+// A FilterCache is used by one thread with one FilterEngine, Clear() it when the filters change or the ids are reused.
+class FilterCache
+{
+public:
+	void Clear();
+	bool Contains(size_t id) const;
+	void Store(size_t id, const FilterMatch& match);
+	void Load(const std::vector<Filter>& filters, size_t id, FilterMatch& match) const;
+
+private:
+	boost::dynamic_bitset<> m_evaluated;
+	std::vector<boost::dynamic_bitset<>> m_matched;
+};
+
+// FilterEngine evaluates a vector of filters against a text with one Aho-Corasick pass for the required literals
+// of all filters. Simple filters are decided by the literal pass alone, the regex of any other filter only runs
+// when its required literal occurs in the text.
+// The engine is compiled from the filter texts and match types, the 'enable' flags are read when matching.
+class FilterEngine
+{
+public:
+	FilterEngine();
+	explicit FilterEngine(const std::vector<Filter>& filters);
+
+	// 'filters' must be the filters this engine was compiled from
+	void Match(const std::vector<Filter>& filters, const std::string& text, FilterMatch& match) const;
+
+	// 'text' is only evaluated when 'cache' has no match for 'id' yet
+	void Match(const std::vector<Filter>& filters, FilterCache& cache, size_t id, const std::string& text, FilterMatch& match) const;
+
+private:
+	struct Program
+	{
+		bool literal;
+		bool exact;
+	};
+
+	MultiLiteralMatcher m_literals;
+	std::vector<Program> m_programs;
+};
+
+// LogFilterMatch holds the evaluation of a LogFilter for one message
+struct LogFilterMatch
+{
+	bool Matched(FilterType::type type) const;
+
+	FilterMatch message;
+	FilterMatch process;
+};
+
+class LogFilterEngine
+{
+public:
+	LogFilterEngine();
+	explicit LogFilterEngine(const LogFilter& filter);
+
+	void Match(const LogFilter& filter, const std::string& processName, const std::string& text, LogFilterMatch& match) const;
+
+	// the process filters are evaluated once per process uid
+	void Match(const LogFilter& filter, FilterCache& processCache, DWORD uid, const std::string& processName, const std::string& text, LogFilterMatch& match) const;
+
+private:
+	FilterEngine m_message;
+	FilterEngine m_process;
+};
+
+// FilterVerdict splits IsIncluded() in two phases. GetFilterVerdict() evaluates everything that does not depend
+// on the order of the lines and can run on any thread. ReduceFilterVerdict() applies the order dependent part:
+// the first match of a Once filter and the colors of new auto colored tokens, it must be called in line order.
+struct FilterVerdict
+{
+	FilterVerdict();
+
+	// the verdict does not depend on or change filter state, Included() is the result
+	bool Stateless() const;
+	bool Included() const;
+
+	bool excluded;
+	bool includeFilterPresent;
+	bool included;
+	std::vector<size_t> once;			// the matched Once filters
+	std::vector<std::string> keys;		// the MatchColors keys of the auto colored filters, in filter order
+};
+
+void GetFilterVerdict(const std::vector<Filter>& filters, const FilterMatch& match, const std::string& text, FilterVerdict& verdict);
+bool ReduceFilterVerdict(std::vector<Filter>& filters, const FilterVerdict& verdict, MatchColors& matchColors);
+
+// the process filters are reduced first, the message filters only when the process filters include the line
+struct LogFilterVerdict
+{
+	bool Stateless() const;
+	bool Included() const;
+
+	FilterVerdict process;
+	FilterVerdict message;
+};
+
+void GetLogFilterVerdict(const LogFilter& filter, const LogFilterMatch& match, const std::string& processName, const std::string& text, LogFilterVerdict& verdict);
+bool ReduceLogFilterVerdict(LogFilter& filter, const LogFilterVerdict& verdict, MatchColors& matchColors);
+
+// same as IsIncluded(filters, text, matchColors), using the result of FilterEngine::Match()
+bool IsIncluded(std::vector<Filter>& filters, const FilterMatch& match, const std::string& text, MatchColors& matchColors);
+
+} // namespace debugviewpp
+} // namespace fusion
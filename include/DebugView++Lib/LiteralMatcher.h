@@ -0,0 +1,69 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <boost/utility/string_ref.hpp>
+#include "MatchType.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+// position of the first occurrence of the lower case 'literal' in 'text' at or after 'pos', ASCII letters compare case insensitive.
+// 16 positions are tested at once with SSE2 on the first and last character of the literal.
+size_t FindNoCase(boost::string_ref text, boost::string_ref literal, size_t pos = 0);
+
+// LiteralMatcher matches MatchType::Simple and MatchType::Wildcard filters without std::regex.
+// ASCII letters compare case insensitive like std::regex::icase does in the "C" locale,
+// a filter text with other than ASCII characters is not literal and should use its std::regex.
+class LiteralMatcher
+{
+public:
+	LiteralMatcher();
+	LiteralMatcher(const std::string& text, MatchType::type matchType);
+
+	bool IsLiteral() const;
+
+	// a literal Simple filter, Find() returns the positions of its matches
+	bool IsSimple() const;
+
+	// same result as std::regex_search() with MakePattern(matchType, text) and std::regex::icase
+	bool Search(boost::string_ref text) const;
+
+	// IsSimple() only
+	size_t Find(boost::string_ref text, size_t pos) const;
+	const std::string& Literal() const;
+
+private:
+	static const size_t unbounded = ~size_t(0);
+
+	// a literal segment of a wildcard, 'gap' is the maximum number of characters between the previous segment and this one,
+	// 'greedy' is set when all later gaps are unbounded, then the first occurrence of this segment is the only one to try
+	struct Segment
+	{
+		explicit Segment(size_t gap) :
+			gap(gap),
+			greedy(false)
+		{
+		}
+
+		std::string text;
+		size_t gap;
+		bool greedy;
+	};
+
+	bool Match(boost::string_ref text, size_t segment, size_t pos) const;
+
+	bool m_literal;
+	bool m_simple;
+	std::vector<Segment> m_segments;
+};
+
+} // namespace debugviewpp
+} // namespace fusion
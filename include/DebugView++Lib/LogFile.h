@@ -9,6 +9,9 @@
 
 #include <string>
 #include <vector>
+#include <memory>
+#include <boost/shared_ptr.hpp>
+#include <boost/atomic.hpp>
 #include "DebugView++Lib/Colors.h"
 #include "DebugView++Lib/ProcessInfo.h"
 #include "IndexedStorageLib/IndexedStorage.h"
@@ -16,6 +19,8 @@
 namespace fusion {
 namespace debugviewpp {
 
+class MappedLogFile;
+
 struct Message
 {
 	Message(double time, FILETIME systemTime, DWORD pid, const std::string& processName, const std::string& msg, COLORREF color = Colors::BackGround);
@@ -28,6 +33,43 @@ struct Message
 	COLORREF color;
 };
 
+// flags of a line, computed from its text when the line is added
+struct LineFlags
+{
+	enum type
+	{
+		NonAscii = 1,		// the text has characters outside 7-bit ASCII
+		Tabs = 2			// the text has tab characters
+	};
+};
+
+// LineColumns points into the columns of one block of lines of a LogFile, element k describes line 'begin' + k.
+// 'uid' is the process uid, see LogFile::GetProcessProperties(). 'block' keeps the columns valid,
+// also after the lines are dropped from the LogFile.
+struct LineColumns
+{
+	LineColumns();
+
+	size_t begin;
+	size_t count;
+	const double* time;
+	const FILETIME* systemTime;
+	const DWORD* uid;
+	const unsigned* length;
+	const unsigned char* flags;
+	boost::shared_ptr<const void> block;
+};
+
+// LogFile supports one writer thread (Add, Clear) and any number of reader threads.
+// Appending takes no locks, see AppendVector and SnappyStorage. Clear() replaces all storage
+// at once, readers that still use the old storage keep it alive until they are done.
+// With a history size set, whole blocks of lines are dropped from the front when the history is full,
+// BeginIndex() then advances and line indexes below it are no longer valid.
+// With a storage directory set, sealed text blocks are spilled to memory mapped segment files in that directory.
+// Load() starts the log with the lines of a MappedLogFile, their text is read from the mapped file when accessed.
+// When the history size is exceeded, the lines of the file are dropped at once.
+// Everything but the text of a line is stored in columns, see GetColumns(). Scanning the times or processes of
+// many lines this way does not touch the text or allocate strings.
 class LogFile
 {
 public:
@@ -36,31 +78,111 @@ public:
 	bool Empty() const;
 	void Clear();
 	void Add(const Message& msg);
+	void Load(const boost::shared_ptr<const MappedLogFile>& file, const std::string& name, FILETIME fileTime);
 	size_t BeginIndex() const;
 	size_t EndIndex() const;
 	size_t Count() const;
 	Message operator[](size_t i) const;
+	indexedstorage::SharedStringRef GetText(size_t i) const;
+	double GetTime(size_t i) const;
+	FILETIME GetSystemTime(size_t i) const;
+	DWORD GetProcessUid(size_t i) const;
+	ProcessProperties GetProcessProperties(DWORD uid) const;
+
+	// the columns of line i up to the end of its block or EndIndex(), throws std::out_of_range like operator[]
+	LineColumns GetColumns(size_t i) const;
+
 	size_t GetHistorySize() const;
 	void SetHistorySize(size_t size);
+	std::wstring GetStorageDirectory() const;
+	void SetStorageDirectory(const std::wstring& directory);
 
 private:
 	struct InternalMessage
 	{
-		InternalMessage(double time, FILETIME systemTime, DWORD uid) :
-			time(time), systemTime(systemTime), uid(uid)
+		InternalMessage() :
+			time(0), uid(0), length(0), flags(0)
+		{
+			systemTime.dwLowDateTime = 0;
+			systemTime.dwHighDateTime = 0;
+		}
+
+		InternalMessage(double time, FILETIME systemTime, DWORD uid, unsigned length, unsigned char flags) :
+			time(time), systemTime(systemTime), uid(uid), length(length), flags(flags)
 		{
 		}
 
 		double time;
 		FILETIME systemTime;
 		DWORD uid;
+		unsigned length;
+		unsigned char flags;
+	};
+
+	// one vector per member of InternalMessage
+	struct MessageColumns
+	{
+		explicit MessageColumns(size_t size = 0);
+
+		size_t Size() const;
+		InternalMessage Get(size_t i) const;
+		void Set(size_t i, const InternalMessage& msg);
+		void PushBack(const InternalMessage& msg);
+		void GetColumns(size_t i, size_t end, LineColumns& columns) const;
+
+		std::vector<double> time;
+		std::vector<FILETIME> systemTime;
+		std::vector<DWORD> uid;
+		std::vector<unsigned> length;
+		std::vector<unsigned char> flags;
+	};
+
+	struct MessageBlock
+	{
+		MessageBlock() :
+			messages(indexedstorage::blockSize)
+		{
+		}
+
+		MessageColumns messages;
+	};
+
+	struct FileLines
+	{
+		boost::shared_ptr<const MappedLogFile> file;
+		MessageColumns messages;
 	};
 
-	std::vector<InternalMessage> m_messages;
-	ProcessInfo m_processInfo;
-	mutable indexedstorage::SnappyStorage m_storage;
-//	indexedstorage::VectorStorage m_storage;
+	// lines [0, fileCount) are the lines of a loaded file, as long as 'file' is set,
+	// line i >= fileCount is stored at i - fileCount in 'messages' and 'text'
+	struct Storage
+	{
+		explicit Storage(std::unique_ptr<indexedstorage::BlockStore> store) :
+			endIndex(0),
+			fileCount(0),
+			text(std::move(store))
+		{
+		}
+
+		boost::atomic<size_t> endIndex;
+		size_t fileCount;
+		boost::shared_ptr<const FileLines> file;
+		indexedstorage::BlockRing<MessageBlock> messages;
+		boost::shared_ptr<MessageBlock> tail;
+		ProcessInfo processInfo;
+		indexedstorage::SnappyStorage text;
+	};
+
+	boost::shared_ptr<Storage> CreateStorage() const;
+	boost::shared_ptr<const Storage> GetStorage() const;
+	static size_t GetBeginIndex(const Storage& storage);
+	static InternalMessage GetInternalMessage(const Storage& storage, size_t i);
+	static indexedstorage::SharedStringRef GetStorageText(const Storage& storage, size_t i);
+	void TrimHistory();
+
+	boost::shared_ptr<Storage> m_storage;
 	size_t m_historySize;
+	std::wstring m_storageDirectory;
 };
 
 } // namespace debugviewpp 
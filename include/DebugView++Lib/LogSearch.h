@@ -0,0 +1,90 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/utility/string_ref.hpp>
+#include "CobaltFusion/GuiExecutor.h"
+#include "DebugView++Lib/Filter.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+class LogFile;
+class TrigramIndex;
+
+// LogSearch searches the lines of a LogFile for a text on its own thread. The matching lines are streamed
+// to the thread that created the LogSearch through a GuiExecutor, where they are kept in line order,
+// so Next() and Previous() are binary searches. Notify() makes the worker search the lines that were added
+// since, new lines extend the matches without searching the log again.
+// Simple searches only read the text of the lines in the candidate blocks of the TrigramIndex.
+// All members but Notify() are called by the creating thread, 'update' is called on that thread after
+// matches were added and must not destroy the LogSearch.
+class LogSearch : boost::noncopyable
+{
+public:
+	// throws std::regex_error for an invalid regular expression
+	LogSearch(const LogFile& logFile, const TrigramIndex& textIndex, const std::string& text, MatchType::type matchType, std::function<void ()> update);
+	~LogSearch();
+
+	const std::string& GetText() const;
+	MatchType::type GetMatchType() const;
+
+	// called after adding one or more lines to the LogFile
+	void Notify();
+
+	// the matches of the lines below EndIndex() are complete
+	size_t EndIndex() const;
+	bool Done() const;
+
+	// percentage of the lines in the LogFile that are searched
+	int Progress() const;
+
+	// number of matches, the matches of lines that were dropped from the LogFile history are removed
+	size_t Count() const;
+
+	// number of matches that were removed since the start of the search
+	size_t Dropped() const;
+
+	// match i in line order, i < Count()
+	int GetMatch(size_t i) const;
+
+	// the first match after 'line' or the last match before 'line', -1 when there is none
+	int Next(int line) const;
+	int Previous(int line) const;
+
+private:
+	void Run();
+	bool IsMatch(boost::string_ref text) const;
+	void Post(const std::vector<int>& matches, size_t end);
+	void Merge(const std::vector<int>& matches, size_t end);
+
+	const LogFile& m_logFile;
+	const TrigramIndex& m_textIndex;
+	Filter m_filter;
+	std::function<void ()> m_update;
+	size_t m_beginIndex;
+	size_t m_endIndex;
+	size_t m_dropped;
+	std::deque<int> m_matches;
+	boost::atomic<bool> m_pending;
+	boost::atomic<bool> m_stop;
+	boost::mutex m_mutex;
+	boost::condition_variable m_cond;
+	GuiExecutor m_executor;
+	boost::thread m_thread;
+};
+
+} // namespace debugviewpp
+} // namespace fusion
@@ -13,11 +13,12 @@
 #pragma warning(push, 1)
 #include <boost/thread.hpp>
 #pragma warning(pop)
+#include <boost/atomic.hpp>
 #include "Win32/Win32Lib.h"
 #include "DebugView++Lib/LogSource.h"
 #include "DebugView++Lib/LineBuffer.h"
-#include "DebugView++Lib/VectorLineBuffer.h"
-#include "CobaltFusion/CircularBuffer.h"
+#include "DebugView++Lib/CircularLineBuffer.h"
+#include "DebugView++Lib/OverflowPolicy.h"
 #include "CobaltFusion/GuiExecutor.h"
 #include "DebugView++Lib/NewlineFilter.h"
 #include "DebugView++Lib/ProcessMonitor.h"
@@ -71,10 +72,31 @@ public:
 	void SetAutoNewLine(bool value);
 	bool GetAutoNewLine() const;
 
+	// the lines a polled source (process, pipe, dbgview) queues until the LogSources thread takes them,
+	// the counters include the sources that were removed
+	size_t GetSourceLimit() const;
+	OverflowPolicy::type GetSourcePolicy() const;
+	void SetSourceLimit(size_t lines, OverflowPolicy::type policy);
+	StageCounters GetSourceCounters() const;
+
+	// the line buffer all sources add to, its size is fixed. By default the newest lines are dropped when it is full,
+	// with OverflowPolicy::Block the DBWIN reader waits and with it every process that calls OutputDebugString
+	OverflowPolicy::type GetLineBufferPolicy() const;
+	void SetLineBufferPolicy(OverflowPolicy::type policy);
+	StageCounters GetLineBufferCounters() const;
+
+	// the normalized lines waiting for GetLines(), when full the normalize thread waits and the line buffer fills up,
+	// 'blocked' counts the times the normalize thread waited
+	size_t GetNormalizeLimit() const;
+	void SetNormalizeLimit(size_t lines);
+	StageCounters GetNormalizeCounters() const;
+
 	void Reset();
 	void Listen();
 	void ListenUntilUpdateEvent();
 	void Abort();
+
+	// the lines are split, trimmed and get their pid on a worker thread, GetLines() takes the lines it has processed
 	Lines GetLines();
 	void Remove(LogSource* pLogSource);
 	std::vector<LogSource*> GetSources() const;
@@ -101,15 +123,25 @@ private:
 	void DelayedUpdate();
 	Loopback* CreateLoopback(Timer& timer, ILineBuffer& lineBuffer);
 	bool LogSourceExists(const LogSource* pLogSource) const;
+	void NotifyNormalize();
+	void Normalize();
+	void NormalizeLines(Lines& inputLines, Lines& lines);
+	void FlushEndedProcesses(const std::vector<std::pair<DWORD, HANDLE>>& processes);
+	void FlushRemovedSources();
+	void AddFlushedLines(const Lines& lines);
 
 	bool m_autoNewLine;
+	size_t m_sourceLimit;
+	OverflowPolicy::type m_sourcePolicy;
+	StageCounters m_removedSourceCounters;	// guarded by m_mutex, the totals of the sources that were removed
 	mutable boost::mutex m_mutex;
+	boost::mutex m_sourcesInUseMutex;	// held to change m_sources and by the normalize thread while it uses the sources of its lines
 	std::vector<std::unique_ptr<LogSource>> m_sources;
+	std::vector<const LogSource*> m_removedSources;	// guarded by m_sourcesInUseMutex, their partial lines are not flushed yet
 	Win32::Handle m_updateEvent;
 	bool m_end;
-	VectorLineBuffer m_linebuffer;
+	CircularLineBuffer m_linebuffer;
 	PidMap m_pidMap;
-	ProcessMonitor m_processMonitor;
 	NewlineFilter m_newlineFilter;
 	Loopback* m_loopback;
 	Timer m_timer;
@@ -118,6 +150,21 @@ private:
 	bool m_updatePending;
 	Update m_update;
 
+	// the normalize thread owns m_pidMap, m_processMonitor.Add() and m_newlineFilter
+	mutable boost::mutex m_normalizeMutex;
+	boost::condition_variable m_normalizeCond;
+	boost::atomic<bool> m_normalizePending;
+	bool m_normalizeEnd;
+	size_t m_normalizeLimit;
+	StageCounters m_normalizeCounters;
+	Lines m_lines;
+	std::vector<std::pair<DWORD, HANDLE>> m_endedProcesses;
+	boost::thread m_normalizeThread;
+
+	// OnProcessEnded() uses the normalize members, the monitor thread is joined before they are destroyed
+	ProcessMonitor m_processMonitor;
+	boost::signals2::scoped_connection m_processEndedConnection;
+
 	// make sure this thread is last to initialize
 	boost::thread m_listenThread;
 };
@@ -0,0 +1,58 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <boost/utility/string_ref.hpp>
+#include <boost/noncopyable.hpp>
+#include "Win32/Win32Lib.h"
+#include "DebugView++Lib/FileIO.h"
+#include "DebugView++Lib/Line.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+// Append the offset of the start of each line in data[0, size) to 'lines', lines end at '\n'.
+// The buffer is scanned for newlines 16 bytes at a time with SSE2.
+void IndexLines(const char* data, size_t size, std::vector<size_t>& lines);
+
+// MappedLogFile maps a DebugView++ or Sysinternals log file into memory as a whole
+// and indexes the start of each line, the lines themselves are not copied.
+// The text of a line is only paged in from the file when it is accessed.
+class MappedLogFile : boost::noncopyable
+{
+public:
+	MappedLogFile(const std::wstring& filename, FileType::type fileType);
+
+	FileType::type GetFileType() const;
+	size_t Count() const;
+	boost::string_ref GetLine(size_t i) const;
+	boost::string_ref GetText(size_t i) const;
+
+	// Read the time and process columns of all lines, line.message is left empty.
+	// The lines are parsed in parallel, 'add' is called on the calling thread in line order.
+	void ReadLines(const std::string& name, FILETIME fileTime, const std::function<void (const Line& line)>& add) const;
+
+private:
+	// number of lines parsed by a worker thread at a time
+	static const size_t chunkSize = 16384;
+
+	FileType::type m_fileType;
+	Win32::Handle m_file;
+	Win32::Handle m_mapping;
+	std::unique_ptr<Win32::MappedViewOfFile> m_view;
+	const char* m_data;
+	size_t m_size;
+	std::vector<size_t> m_lines;
+};
+
+} // namespace debugviewpp 
+} // namespace fusion
@@ -8,21 +8,40 @@
 #pragma once
 
 #include <string>
+#include <utility>
+#include <functional>
 #include <unordered_map>
+#include <boost/functional/hash.hpp>
 
 namespace fusion {
 namespace debugviewpp {
 
 struct Line;
+class LogSource;
 
 class NewlineFilter
 {
 public:
-	Lines Process(const Line& line);
+	// appends the lines of 'line.message' to 'lines', without line ends and '\r' characters.
+	// the text after the last newline is kept until the next message of the same source and process,
+	// it is added at once when the source uses auto newline or the text exceeds maxLineSize.
+	// the strings of 'line' are moved to the output where possible, 'line' is left unspecified.
+	void Process(Line& line, Lines& lines);
+
 	Lines FlushLinesFromTerminatedProcess(DWORD pid, HANDLE handle);
 
+	// flushes and forgets the partial lines of a source that is removed, a new source can get the same address
+	Lines FlushLinesFromSource(const LogSource* pSource);
+
 private:
-	std::unordered_map<DWORD, std::string> m_lineBuffers;
+	static const size_t maxLineSize = 8192;	// prevents stack overflow in handling code
+
+	typedef std::pair<const LogSource*, DWORD> Key;
+
+	// appends the partial lines of the keys that match 'predicate' to 'lines' and forgets them
+	void Flush(const std::function<bool (const Key& key)>& predicate, Lines& lines);
+
+	std::unordered_map<Key, std::string, boost::hash<Key>> m_lineBuffers;
 };
 
 } // namespace debugviewpp 
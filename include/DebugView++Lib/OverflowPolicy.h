@@ -0,0 +1,45 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <string>
+
+namespace fusion {
+namespace debugviewpp {
+
+// what a bounded stage of the ingest pipeline does with a line that does not fit
+struct OverflowPolicy
+{
+	enum type
+	{
+		Block,			// the producer waits until the consumer has taken the queued lines
+		DropOldest,		// the oldest queued lines are discarded to make room
+		DropNewest		// the new line is discarded, the consumer receives a "N lines dropped" line in its place
+	};
+};
+
+std::string OverflowPolicyToString(OverflowPolicy::type policy);
+
+// the lines that passed through a bounded stage
+struct StageCounters
+{
+	StageCounters();
+
+	size_t added;		// queued lines, including the ones that were dropped later by OverflowPolicy::DropOldest
+	size_t dropped;
+	size_t blocked;		// lines for which the producer had to wait
+	size_t peak;		// the largest number of lines queued at once
+};
+
+StageCounters& operator+=(StageCounters& counters, const StageCounters& stage);
+
+// the message of the line that takes the place of 'count' lines dropped by OverflowPolicy::DropNewest
+std::string GetDroppedLinesMessage(size_t count);
+
+} // namespace debugviewpp
+} // namespace fusion
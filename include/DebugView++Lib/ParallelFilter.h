@@ -0,0 +1,88 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include "DebugView++Lib/Filter.h"
+#include "DebugView++Lib/FilterEngine.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+class LogFile;
+
+struct FilteredLine
+{
+	FilteredLine(int line, bool stateful);
+
+	int line;
+	bool stateful;		// a Once or auto colored filter matched, ReduceLogFilterVerdict() decides
+};
+
+// the lines of one block of a LogFile that are included or depend on filter state, in line order.
+// 'verdicts' holds the verdict of each stateful line, in the same order.
+struct FilteredBlock
+{
+	std::vector<FilteredLine> lines;
+	std::vector<LogFilterVerdict> verdicts;
+};
+
+// ParallelFilter evaluates a LogFilter over the lines [begin, end) of a LogFile on a pool of worker threads,
+// one block of indexedstorage::blockSize lines at a time. This is the first phase of the filter evaluation:
+// the workers decide the lines that do not depend on filter state and compute the LogFilterVerdict of the others.
+// Poll() hands the filtered blocks to the owner thread in line order, the owner reduces the verdicts of the
+// stateful lines in that order, which gives the same Once matches and token colors as a sequential pass.
+// The LogFile must outlive the ParallelFilter, destruction cancels the pass and joins the workers.
+class ParallelFilter : boost::noncopyable
+{
+public:
+	ParallelFilter(const LogFile& logFile, const LogFilter& filter, size_t begin, size_t end);
+	~ParallelFilter();
+
+	// calls 'merge' for each filtered block that is next in line order, does not wait for the workers.
+	// returns the number of merged blocks.
+	size_t Poll(const std::function<void (const FilteredBlock& block)>& merge);
+
+	// waits until the workers have filtered all blocks, Poll() then merges the remaining blocks at once
+	void Wait();
+
+	bool Done() const;
+
+	// percentage of the blocks that are merged
+	int Progress() const;
+
+private:
+	static const size_t maxPendingBlocks = 1024;
+
+	void Run();
+	void FilterBlock(size_t block, FilterCache& processCache, LogFilterMatch& match, LogFilterVerdict& verdict, FilteredBlock& result) const;
+
+	const LogFile& m_logFile;
+	LogFilter m_filter;
+	LogFilterEngine m_engine;
+	size_t m_begin;
+	size_t m_end;
+	size_t m_firstBlock;
+	size_t m_blocks;
+	boost::atomic<bool> m_cancel;
+	mutable boost::mutex m_mutex;
+	boost::condition_variable m_cond;
+	size_t m_nextBlock;
+	size_t m_filteredBlocks;
+	size_t m_mergedBlocks;
+	std::vector<std::unique_ptr<FilteredBlock>> m_results;
+	boost::thread_group m_threads;
+};
+
+} // namespace debugviewpp
+} // namespace fusion
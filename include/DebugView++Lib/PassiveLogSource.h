@@ -7,9 +7,11 @@
 
 #pragma once
 
+#include <deque>
 #include <boost/thread.hpp>
 #include "Win32/Win32Lib.h"
 #include "LogSource.h"
+#include "OverflowPolicy.h"
 
 namespace fusion {
 namespace debugviewpp {
@@ -46,6 +48,11 @@ public:
 	void AddMessage(const std::string& message);
 	void AddMessage(double time, FILETIME systemTime, DWORD pid, const std::string& processName, const std::string& message);
 
+	// bounds the number of lines queued by AddMessage() until the next Notify(),
+	// with OverflowPolicy::Block AddMessage() waits for Notify() unless the source is aborted
+	void SetLimit(size_t capacity, OverflowPolicy::type policy);
+	StageCounters GetCounters() const;
+
 	void Signal();
 	void StartThread();
 
@@ -53,11 +60,17 @@ public:
 
 private:
 	void Loop();
+	void Queue(const PollLine& line);
 
-	std::vector<PollLine> m_lines;
-	std::vector<PollLine> m_backBuffer;
+	std::deque<PollLine> m_lines;
+	std::deque<PollLine> m_backBuffer;
+	size_t m_capacity;
+	OverflowPolicy::type m_policy;
+	StageCounters m_counters;
+	size_t m_droppedLines;	// OverflowPolicy::DropNewest lines since the last Notify()
 	Win32::Handle m_handle;
-	boost::mutex m_mutex;
+	mutable boost::mutex m_mutex;
+	boost::condition_variable m_cond;
 	boost::chrono::microseconds m_microsecondInterval;
 	boost::thread m_thread;
 };
@@ -8,7 +8,9 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <unordered_map>
+#include "CobaltFusion/AppendVector.h"
 
 #pragma comment(lib, "DebugView++Lib.lib")
 
@@ -35,6 +37,9 @@ struct ProcessProperties
 	COLORREF color;
 };
 
+// ProcessInfo assigns unique ids to (processId, processName) pairs.
+// GetUid() and Clear() must be called from one writer thread,
+// GetProcessProperties(uid) can be called concurrently from reader threads.
 class ProcessInfo
 {
 public:
@@ -50,8 +55,8 @@ public:
 	ProcessProperties GetProcessProperties(DWORD uid) const;
 
 private:
-	std::unordered_map<DWORD, InternalProcessProperties> m_processProperties;
-	DWORD m_unqiueId;
+	AppendVector<InternalProcessProperties, 64> m_processProperties;
+	std::unordered_map<DWORD, std::vector<DWORD>> m_uids;	// the uids of each processId, writer only
 };
 
 } // namespace debugviewpp 
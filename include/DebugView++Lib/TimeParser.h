@@ -0,0 +1,55 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <windows.h>
+#include <boost/utility/string_ref.hpp>
+
+namespace fusion {
+namespace debugviewpp {
+
+// time of day as read from a log file, before it is converted by USTimeConverter
+struct USTime
+{
+	WORD hour;
+	WORD minute;
+	WORD second;
+	WORD milliseconds;
+};
+
+// depending on regional settings Sysinternals debugview logs time differently,
+// all lines of one file use the same format, so it only needs to be detected once per file.
+struct TimeFormat
+{
+	enum type
+	{
+		Unknown = 0,
+		USRegionMs,		// hh:MM:SS.mmm tt
+		USRegion,		// hh:MM:SS tt
+		LocalMs,		// HH:MM:SS.mmm
+		Local,			// HH:MM:SS
+		Relative		// S.mmmmmm
+	};
+};
+
+// The parsers below are fixed-format and locale independent, they do not allocate and fail on
+// out-of-range fields instead of passing them on to the Win32 time conversions.
+
+TimeFormat::type DetectTimeFormat(boost::string_ref text);
+
+// parse a time of day in one of the formats USRegionMs, USRegion, LocalMs or Local, AM/PM is applied to 'time'
+bool ParseTimeOfDay(boost::string_ref text, TimeFormat::type format, USTime& time);
+
+// parse a relative time in seconds, the whole text must be a number
+bool ParseRelativeTime(boost::string_ref text, double& time);
+
+// parse "yyyy/MM/dd HH:mm:ss.mmm" as written by WriteLogFileMessage
+bool ParseDateTime(boost::string_ref text, SYSTEMTIME& st);
+
+} // namespace debugviewpp
+} // namespace fusion
@@ -0,0 +1,79 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <string>
+#include <deque>
+#include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/dynamic_bitset.hpp>
+#include <boost/utility/string_ref.hpp>
+
+namespace fusion {
+namespace debugviewpp {
+
+class LogFile;
+
+// the blocks of a LogFile that can contain a search text, see TrigramIndex::Query()
+class TrigramQuery
+{
+public:
+	TrigramQuery();
+
+	// false when line i can not contain the search text, the line must still be tested when true
+	bool MayContain(size_t i) const;
+
+private:
+	friend class TrigramIndex;
+
+	bool m_all;
+	size_t m_firstBlock;
+	boost::dynamic_bitset<> m_candidates;
+};
+
+// TrigramIndex indexes the text of a LogFile on its own thread, one block of indexedstorage::blockSize lines at a time
+// once the block is complete. Each block gets a signature of signatureBits bits with one bit set per hashed trigram
+// of its lines, ASCII letters folded to lower case like the case insensitive Find does.
+// A search text can only occur in a block that has the bits of all its trigrams set, so a Find only
+// has to test the text of the lines in those blocks and in the last, not yet indexed, lines.
+// Notify() and Clear() are called by the thread that adds lines to the LogFile, Clear() after LogFile::Clear().
+class TrigramIndex : boost::noncopyable
+{
+public:
+	explicit TrigramIndex(const LogFile& logFile);
+	~TrigramIndex();
+
+	// called after adding one or more lines to the LogFile
+	void Notify();
+	void Clear();
+
+	TrigramQuery Query(const std::string& text) const;
+
+	// number of indexed blocks
+	size_t Size() const;
+
+private:
+	static const int signatureBits = 14;
+
+	void Run();
+	void IndexBlocks();
+
+	const LogFile& m_logFile;
+	boost::atomic<bool> m_pending;
+	bool m_stop;
+	size_t m_generation;
+	size_t m_firstBlock;
+	std::deque<boost::dynamic_bitset<>> m_signatures;
+	mutable boost::mutex m_mutex;
+	boost::condition_variable m_cond;
+	boost::thread m_thread;
+};
+
+} // namespace debugviewpp
+} // namespace fusion
@@ -0,0 +1,52 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <list>
+#include <unordered_map>
+#include <boost/shared_ptr.hpp>
+#include "IndexedStorageLib/StringArena.h"
+
+namespace fusion {
+namespace indexedstorage {
+
+// BlockCache keeps the most recently used decompressed blocks, limited by their total size in bytes.
+// The least recently used blocks are evicted first, the most recently added block is always kept.
+class BlockCache
+{
+public:
+	typedef boost::shared_ptr<const StringArena> BlockPtr;
+
+	explicit BlockCache(size_t maxBytes);
+
+	void Clear();
+	BlockPtr Get(size_t blockIndex);
+	void Add(size_t blockIndex, BlockPtr block);
+
+	size_t GetMaxBytes() const;
+	void SetMaxBytes(size_t maxBytes);
+	size_t GetBytes() const;
+	size_t GetHits() const;
+	size_t GetMisses() const;
+
+private:
+	typedef std::pair<size_t, BlockPtr> Entry;
+
+	static size_t GetBlockBytes(const StringArena& block);
+	void Evict();
+
+	std::list<Entry> m_lru;
+	std::unordered_map<size_t, std::list<Entry>::iterator> m_index;
+	size_t m_maxBytes;
+	size_t m_bytes;
+	size_t m_hits;
+	size_t m_misses;
+};
+
+} // namespace indexedstorage
+} // namespace fusion
@@ -0,0 +1,137 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace fusion {
+namespace indexedstorage {
+
+// BlockRing holds the blocks [BeginIndex(), EndIndex()) in a ring of slots, for one writer thread
+// and any number of reader threads. PushBack() and PopFront() are O(1), the ring doubles its capacity
+// when it is full, so with a bounded number of blocks the memory use stays flat.
+// Slots are accessed with boost::atomic_load/atomic_store, a reader that asks for a block that was
+// dropped gets a null pointer, a reader that still holds a dropped block keeps it alive.
+template <typename T>
+class BlockRing : boost::noncopyable
+{
+public:
+	BlockRing() :
+		m_slots(boost::make_shared<Slots>()),
+		m_begin(0),
+		m_end(0)
+	{
+	}
+
+	size_t BeginIndex() const
+	{
+		return m_begin.load(boost::memory_order_acquire);
+	}
+
+	size_t EndIndex() const
+	{
+		return m_end.load(boost::memory_order_acquire);
+	}
+
+	size_t Count() const
+	{
+		return EndIndex() - BeginIndex();
+	}
+
+	boost::shared_ptr<const T> Get(size_t index) const
+	{
+		auto slots = boost::atomic_load(&m_slots);
+		auto node = boost::atomic_load(&slots->nodes[index % slots->nodes.size()]);
+		if (!node || node->index != index)
+			return boost::shared_ptr<const T>();
+		return boost::shared_ptr<const T>(node, &node->value);
+	}
+
+	// writer only, the returned block can still be modified by the writer,
+	// it is up to the writer to only publish the parts that are written
+	boost::shared_ptr<T> PushBack(T value)
+	{
+		auto begin = m_begin.load(boost::memory_order_relaxed);
+		auto end = m_end.load(boost::memory_order_relaxed);
+		if (end - begin == m_slots->nodes.size())
+			Grow(begin, end);
+
+		auto node = boost::make_shared<Node>(end, std::move(value));
+		boost::atomic_store(&m_slots->nodes[end % m_slots->nodes.size()], node);
+		m_end.store(end + 1, boost::memory_order_release);
+		return boost::shared_ptr<T>(node, &node->value);
+	}
+
+	// writer only
+	void PopFront()
+	{
+		auto begin = m_begin.load(boost::memory_order_relaxed);
+		if (begin == m_end.load(boost::memory_order_relaxed))
+			return;
+
+		m_begin.store(begin + 1, boost::memory_order_release);
+		boost::atomic_store(&m_slots->nodes[begin % m_slots->nodes.size()], boost::shared_ptr<Node>());
+	}
+
+	// writer only, drops all blocks and restarts at index 0
+	void Clear()
+	{
+		boost::atomic_store(&m_slots, boost::make_shared<Slots>());
+		m_begin.store(0, boost::memory_order_release);
+		m_end.store(0, boost::memory_order_release);
+	}
+
+private:
+	static const size_t initialCapacity = 16;
+
+	struct Node
+	{
+		Node(size_t index, T&& value) :
+			index(index),
+			value(std::move(value))
+		{
+		}
+
+		size_t index;
+		T value;
+	};
+
+	struct Slots
+	{
+		Slots() :
+			nodes(initialCapacity)
+		{
+		}
+
+		explicit Slots(size_t capacity) :
+			nodes(capacity)
+		{
+		}
+
+		std::vector<boost::shared_ptr<Node>> nodes;
+	};
+
+	void Grow(size_t begin, size_t end)
+	{
+		auto slots = boost::make_shared<Slots>(2 * m_slots->nodes.size());
+		for (auto i = begin; i != end; ++i)
+			slots->nodes[i % slots->nodes.size()] = m_slots->nodes[i % m_slots->nodes.size()];
+		boost::atomic_store(&m_slots, slots);
+	}
+
+	boost::shared_ptr<Slots> m_slots;
+	boost::atomic<size_t> m_begin;
+	boost::atomic<size_t> m_end;
+};
+
+} // namespace indexedstorage
+} // namespace fusion
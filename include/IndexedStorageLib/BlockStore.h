@@ -0,0 +1,67 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <string>
+#include <boost/utility/string_ref.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include "IndexedStorageLib/BlockRing.h"
+
+namespace fusion {
+namespace indexedstorage {
+
+// SharedStringRef refers to a string in a block of the storage and keeps that block alive,
+// so it stays valid when the storage evicts, seals or drops the block in the meantime.
+class SharedStringRef
+{
+public:
+	SharedStringRef();
+	SharedStringRef(boost::string_ref value, boost::shared_ptr<const void> block);
+
+	boost::string_ref str() const;
+	operator boost::string_ref() const;
+
+private:
+	boost::string_ref m_value;
+	boost::shared_ptr<const void> m_block;
+};
+
+// BlockStore holds the sealed compressed blocks [BeginIndex(), EndIndex()) of a SnappyStorage.
+// PushBack(), PopFront() and Clear() are called by the writer thread only, Get() can be called
+// concurrently by reader threads and returns false for a block that was dropped.
+class BlockStore : boost::noncopyable
+{
+public:
+	virtual ~BlockStore();
+
+	virtual size_t BeginIndex() const = 0;
+	virtual size_t EndIndex() const = 0;
+	virtual void PushBack(const char* data, size_t size) = 0;
+	virtual void PopFront() = 0;
+	virtual void Clear() = 0;
+	virtual bool Get(size_t index, SharedStringRef& block) const = 0;
+};
+
+// MemoryBlockStore keeps all blocks in memory
+class MemoryBlockStore : public BlockStore
+{
+public:
+	virtual size_t BeginIndex() const;
+	virtual size_t EndIndex() const;
+	virtual void PushBack(const char* data, size_t size);
+	virtual void PopFront();
+	virtual void Clear();
+	virtual bool Get(size_t index, SharedStringRef& block) const;
+
+private:
+	BlockRing<std::string> m_blocks;
+};
+
+} // namespace indexedstorage
+} // namespace fusion
@@ -7,14 +7,25 @@
 
 #pragma once
 
+#include <string>
 #include <vector>
-#include "../libsnappy/libsnappy.h"
+#include <memory>
+#include <boost/utility/string_ref.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include "IndexedStorageLib/StringArena.h"
+#include "IndexedStorageLib/BlockCache.h"
+#include "IndexedStorageLib/BlockStore.h"
 
 #pragma comment(lib, "IndexedStorageLib.lib")
 
 namespace fusion {
 namespace indexedstorage {
 
+// number of strings per compressed block
+const size_t blockSize = 400;
+
 class VectorStorage
 {
 public:
@@ -28,32 +39,60 @@ private:
 	std::vector<std::string> m_storage;
 };
 
+// SnappyStorage appends strings into the tail block, when blockSize strings are collected
+// the tail block is compressed as a whole into one sealed, immutable block.
+// Reads decompress a sealed block into an arena that is kept in an LRU cache of decompressed blocks,
+// so readers at different positions in the storage do not evict each other's block.
+//
+// SnappyStorage supports one writer thread (Add, Clear, SetCacheSize) and any number of reader threads.
+// Add() takes no locks: a line is published by a release-store of the line count after its text is written
+// to the tail block, which never moves text once written. A full tail block is sealed by first publishing
+// the compressed block and only then replacing the tail, so a reader always finds a line in one of the two.
+// PopFront() drops the oldest sealed block in O(1), BeginIndex() then advances by blockSize.
+// Clear() must not be called while there are readers, LogFile replaces its whole storage instead.
+// The sealed blocks are kept in a BlockStore, by default in memory, a MappedFileBlockStore spills them to disk
+// so only the block index, the tail block and the cache of decompressed blocks stay resident.
 class SnappyStorage
 {
 public:
-	SnappyStorage();
+	static const size_t defaultCacheSize = 4*1024*1024;
+
+	explicit SnappyStorage(size_t cacheSize = defaultCacheSize);
+	explicit SnappyStorage(std::unique_ptr<BlockStore> store, size_t cacheSize = defaultCacheSize);
 
 	bool Empty() const;
 	void Clear();
-	size_t Add(const std::string& value);
+	size_t Add(boost::string_ref value);
+	void PopFront();
+	size_t BeginIndex() const;
+	size_t EndIndex() const;
 	size_t Count() const;
-	std::string operator[](size_t i);
+	std::string operator[](size_t i) const;
+	SharedStringRef GetStringRef(size_t i) const;
 
-	std::string Compress(const std::vector<std::string>& value) const;
-	std::vector<std::string> Decompress(const std::string& value) const;
+	size_t GetCacheSize() const;
+	void SetCacheSize(size_t bytes);
+	size_t GetCacheHits() const;
+	size_t GetCacheMisses() const;
 
 private:
+	class TailBlock;
+
 	size_t GetBlockIndex(size_t index) const;
 	size_t GetRelativeIndex(size_t index) const;
-	std::string GetString(size_t index);
+	void Seal();
+	void Compress(TailBlock& block);
+	BlockCache::BlockPtr GetBlock(size_t blockIndex) const;
+	BlockCache::BlockPtr Decompress(boost::string_ref block) const;
 
-	size_t m_writeBlockIndex;
-	size_t m_readBlockIndex;
-	std::vector<std::string> m_readList;
-	std::vector<std::string> m_writeList;
+	boost::atomic<size_t> m_count;
+	boost::shared_ptr<TailBlock> m_tail;
+	std::unique_ptr<BlockStore> m_storage;
+	std::vector<char> m_compressBuffer;
 
-	std::vector<std::string> m_storage;
+	mutable boost::mutex m_cacheMutex;
+	mutable BlockCache m_cache;
 };
-	
+
 } // namespace indexedstorage 
 } // namespace fusion
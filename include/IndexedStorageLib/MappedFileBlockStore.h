@@ -0,0 +1,79 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <string>
+#include <list>
+#include <memory>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include "IndexedStorageLib/BlockStore.h"
+
+namespace Win32 {
+
+class MappedViewOfFile;
+
+} // namespace Win32
+
+namespace fusion {
+namespace indexedstorage {
+
+// MappedFileBlockStore writes the blocks into segment files in 'directory', only the location of each block
+// is kept in memory. The segment files are temporary files that are deleted when the last block in them is dropped.
+// Only the segment that is being written is mapped as a whole, blocks are read through a small cache of
+// viewSize views that are mapped on demand, so the address space used stays bounded on 32-bit builds.
+// When a segment can not be created or mapped, the following blocks are kept in memory until the next Clear().
+class MappedFileBlockStore : public BlockStore
+{
+public:
+	static const size_t defaultSegmentSize = 64*1024*1024;
+	static const size_t viewSize = 4*1024*1024;		// a multiple of the allocation granularity
+	static const size_t viewCacheSize = 8;
+
+	explicit MappedFileBlockStore(const std::wstring& directory, size_t segmentSize = defaultSegmentSize);
+	virtual ~MappedFileBlockStore();
+
+	virtual size_t BeginIndex() const;
+	virtual size_t EndIndex() const;
+	virtual void PushBack(const char* data, size_t size);
+	virtual void PopFront();
+	virtual void Clear();
+	virtual bool Get(size_t index, SharedStringRef& block) const;
+
+private:
+	class Segment;
+	class View;
+
+	struct Location
+	{
+		Location(const boost::shared_ptr<Segment>& segment, size_t offset, size_t size);
+		Location(const char* data, size_t size);
+
+		boost::shared_ptr<Segment> segment;
+		size_t offset;
+		size_t size;
+		std::string data;	// the block itself when it is kept in memory
+	};
+
+	void AddSegment(size_t size);
+	boost::shared_ptr<const View> GetView(const boost::shared_ptr<Segment>& segment, size_t offset, size_t size) const;
+
+	std::wstring m_directory;
+	size_t m_segmentSize;
+	bool m_inMemory;
+	boost::shared_ptr<Segment> m_segment;
+	std::unique_ptr<Win32::MappedViewOfFile> m_writeView;
+	size_t m_writeOffset;
+	BlockRing<Location> m_blocks;
+
+	mutable boost::mutex m_viewMutex;
+	mutable std::list<boost::shared_ptr<const View>> m_views;	// most recently used first
+};
+
+} // namespace indexedstorage
+} // namespace fusion
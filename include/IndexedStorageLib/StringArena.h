@@ -0,0 +1,43 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <vector>
+#include <boost/utility/string_ref.hpp>
+
+namespace fusion {
+namespace indexedstorage {
+
+// StringArena stores '\0'-terminated strings back to back in one contiguous buffer
+// and keeps a table of start offsets, so adding a string does not allocate per line
+// and the raw buffer can be compressed as a whole.
+// Clear() keeps the allocated capacity so the arena can be reused for the next block.
+class StringArena
+{
+public:
+	bool Empty() const;
+	void Clear();
+	size_t Add(boost::string_ref value);
+	size_t Count() const;
+	boost::string_ref operator[](size_t i) const;
+
+	const char* Data() const;
+	size_t Size() const;
+
+	// Reset the arena to 'size' bytes of raw string data to be filled in by the caller,
+	// BuildIndex() must be called after filling to rebuild the offset table.
+	char* Reset(size_t size);
+	void BuildIndex();
+
+private:
+	std::vector<char> m_data;
+	std::vector<size_t> m_offsets;
+};
+
+} // namespace indexedstorage
+} // namespace fusion
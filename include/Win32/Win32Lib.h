@@ -279,6 +279,7 @@ DWORD GetExitCodeProcess(const Handle& hProcess);
 
 std::wstring GetWindowText(HWND hWnd);
 std::wstring GetDlgItemText(HWND hDlg, int idc);
+std::wstring GetTempPath();
 bool IsGUIThread();
 
 